@@ -1,9 +1,9 @@
 #include <stdbool.h>
-#include <malloc.h>
 #include <string.h>
 
 #include "aes.h"
 #include "constants.h"
+#include "../Helpers/alloc_track.h"
 #include "../Helpers/helpers.h"
 
 /// Perform XOR on each byte in the block, and store the results in the first argument.
@@ -108,7 +108,7 @@ void derive_previous_key(unsigned char* key, size_t round) {
 }
 
 /// Perform a round of AES. The last_round parameter decides whether the MixColumn step should be performed.
-void perform_round(unsigned char* block, unsigned char* key, bool last_round)
+void perform_round(unsigned char* block, const unsigned char* key, bool last_round)
 {
     sub_bytes(block, SBox, BLOCK_SIZE);
     shift_rows(block);
@@ -120,7 +120,7 @@ void perform_round(unsigned char* block, unsigned char* key, bool last_round)
 
 /// Encrypt a block with a 128-bit key, and a certain number of rounds.
 unsigned char* encrypt(const unsigned char* block, const unsigned char* key, size_t rounds) {
-    unsigned char* data = malloc(BLOCK_SIZE); // create block on heap so that it can be returned later
+    unsigned char* data = tracked_malloc(BLOCK_SIZE); // create block on heap so that it can be returned later
     memcpy(data, block, BLOCK_SIZE);
 
     unsigned char round_key[BLOCK_SIZE];
@@ -158,4 +158,31 @@ unsigned char* encrypt(const unsigned char* block, const unsigned char* key, siz
 #endif
 
     return data;
-}
\ No newline at end of file
+}
+
+/// Derive all round keys for the given number of rounds up front, so that blocks can be encrypted without re-deriving them.
+/// The round_keys buffer has to hold (rounds + 1) * BLOCK_SIZE bytes, where the first block is the cipher key itself.
+void expand_key(const unsigned char* key, unsigned char* round_keys, size_t rounds) {
+    memcpy(round_keys, key, BLOCK_SIZE);
+    for (size_t r = 1; r <= rounds; r++) {
+        memcpy(&round_keys[r * BLOCK_SIZE], &round_keys[(r - 1) * BLOCK_SIZE], BLOCK_SIZE);
+        derive_next_key(&round_keys[r * BLOCK_SIZE], r - 1);
+    }
+}
+
+/// Encrypt a single block with pre-expanded round keys into a caller-provided buffer. In and out may point to the same block.
+/// Unlike encrypt, this does not allocate any memory and can be called from several threads at once.
+void encrypt_block(unsigned char* out, const unsigned char* in, const unsigned char* round_keys, size_t rounds) {
+    memmove(out, in, BLOCK_SIZE);
+    xor_blocks(out, round_keys, BLOCK_SIZE); // initial XOR with key
+    for (size_t r = 1; r <= rounds; r++) {
+        perform_round(out, &round_keys[r * BLOCK_SIZE], r == rounds);
+    }
+}
+
+/// Encrypt n consecutive blocks with pre-expanded round keys. In and out may point to the same buffer.
+void encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds) {
+    for (size_t i = 0; i < n; i++) {
+        encrypt_block(&out[i * BLOCK_SIZE], &in[i * BLOCK_SIZE], round_keys, rounds);
+    }
+}
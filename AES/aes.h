@@ -6,6 +6,11 @@
 
 //#define DEBUG_AES // comment this out to disable debug mode
 
+#define MAX_ROUNDS 10 // Limited by the number of round constants
+
+/// Signature shared by all implementations of encrypt_blocks.
+typedef void (*EncryptBlocksFn)(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds);
+
 void xor_blocks(unsigned char* a, const unsigned char* b, size_t n);
 void sub_bytes(unsigned char* block, const unsigned char* s_box, size_t n);
 void shift_rows(unsigned char* block);
@@ -13,8 +18,12 @@ void mix_columns(unsigned char* block);
 
 void derive_next_key(unsigned char* key, size_t round);
 void derive_previous_key(unsigned char* key, size_t round);
-void perform_round(unsigned char* block, unsigned char* key, bool last_round);
+void perform_round(unsigned char* block, const unsigned char* key, bool last_round);
 
 unsigned char* encrypt(const unsigned char* block, const unsigned char* key, size_t rounds);
 
+void expand_key(const unsigned char* key, unsigned char* round_keys, size_t rounds);
+void encrypt_block(unsigned char* out, const unsigned char* in, const unsigned char* round_keys, size_t rounds);
+void encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds);
+
 #endif //INC_02255_HW1_GROUP33_AES_H
@@ -0,0 +1,75 @@
+#include "aes_ni.h"
+#include "aes.h"
+#include "../Helpers/helpers.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+#define AES_NI_TARGET __attribute__((target("aes,ssse3")))
+#define AES_NI_LANES 8 // Blocks encrypted side by side, to hide the latency of the AES instructions
+
+/// Check whether the CPU supports the AES instructions.
+bool aes_ni_available(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("ssse3");
+}
+
+/// Our blocks are stored row by row, while the AES instructions expect them column by column.
+/// Transposing the 4x4 matrix converts between the two, in both directions.
+AES_NI_TARGET static inline __m128i transpose(__m128i block) {
+    const __m128i order = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    return _mm_shuffle_epi8(block, order);
+}
+
+/// Encrypt blocks with the AES instructions. Since they perform exactly the steps of perform_round,
+/// this works for any number of rounds, and the last round leaves out MixColumns just like ours does.
+AES_NI_TARGET void aes_ni_encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds) {
+    __m128i keys[MAX_ROUNDS + 1];
+    for (size_t r = 0; r <= rounds; r++) {
+        keys[r] = transpose(_mm_loadu_si128((const __m128i*) &round_keys[r * BLOCK_SIZE]));
+    }
+
+    size_t i = 0;
+    for (; i + AES_NI_LANES <= n; i += AES_NI_LANES) {
+        __m128i b[AES_NI_LANES];
+        for (size_t l = 0; l < AES_NI_LANES; l++) {
+            b[l] = _mm_xor_si128(transpose(_mm_loadu_si128((const __m128i*) &in[(i + l) * BLOCK_SIZE])), keys[0]);
+        }
+        for (size_t r = 1; r < rounds; r++) {
+            for (size_t l = 0; l < AES_NI_LANES; l++) {
+                b[l] = _mm_aesenc_si128(b[l], keys[r]);
+            }
+        }
+        for (size_t l = 0; l < AES_NI_LANES; l++) {
+            if (rounds > 0) {
+                b[l] = _mm_aesenclast_si128(b[l], keys[rounds]);
+            }
+            _mm_storeu_si128((__m128i*) &out[(i + l) * BLOCK_SIZE], transpose(b[l]));
+        }
+    }
+
+    for (; i < n; i++) {
+        __m128i b = _mm_xor_si128(transpose(_mm_loadu_si128((const __m128i*) &in[i * BLOCK_SIZE])), keys[0]);
+        for (size_t r = 1; r < rounds; r++) {
+            b = _mm_aesenc_si128(b, keys[r]);
+        }
+        if (rounds > 0) {
+            b = _mm_aesenclast_si128(b, keys[rounds]);
+        }
+        _mm_storeu_si128((__m128i*) &out[i * BLOCK_SIZE], transpose(b));
+    }
+}
+
+#else
+
+bool aes_ni_available(void) {
+    return false;
+}
+
+void aes_ni_encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds) {
+    encrypt_blocks(out, in, n, round_keys, rounds); // Never selected, since the engine is not available
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef INC_02255_HW1_GROUP33_AES_NI_H
+#define INC_02255_HW1_GROUP33_AES_NI_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+bool aes_ni_available(void);
+void aes_ni_encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds);
+
+#endif //INC_02255_HW1_GROUP33_AES_NI_H
@@ -0,0 +1,245 @@
+#include <string.h>
+
+#include "aes_ssse3.h"
+#include "aes.h"
+#include "constants.h"
+#include "../Helpers/helpers.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <tmmintrin.h>
+
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+
+/// Check whether the CPU supports SSSE3, which provides the byte shuffle all of the round functions are built on.
+bool aes_ssse3_available(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+#pragma region Round functions
+
+/// Substitute all 16 bytes without any data-dependent memory access. The S-Box is split into 16 rows of 16 entries, indexed by the high nibble.
+/// For each row, a byte shuffle looks up the low nibble, and the saturating add pushes the index of every byte with a different high nibble to 0x80 or
+/// above, which makes the shuffle return 0 for it. OR-ing the 16 results leaves exactly one looked-up value per byte.
+SSSE3_TARGET static inline __m128i sub_bytes_vec(__m128i block, const __m128i* rows) {
+    __m128i result = _mm_setzero_si128();
+    for (int h = 0; h < 16; h++) {
+        __m128i index = _mm_adds_epu8(_mm_xor_si128(block, _mm_set1_epi8((char) (h << 4))), _mm_set1_epi8(0x70));
+        result = _mm_or_si128(result, _mm_shuffle_epi8(rows[h], index));
+    }
+    return result;
+}
+
+/// Load the 16 rows of an S-Box for sub_bytes_vec.
+SSSE3_TARGET static inline void load_s_box(__m128i* rows, const unsigned char* s_box) {
+    for (int h = 0; h < 16; h++) {
+        rows[h] = _mm_loadu_si128((const __m128i*) &s_box[h * 16]);
+    }
+}
+
+/// ShiftRows as a single shuffle: row r of the block (bytes 4r to 4r + 3) is rotated r positions to the left.
+SSSE3_TARGET static inline __m128i shift_rows_vec(__m128i block) {
+    return _mm_shuffle_epi8(block, _mm_setr_epi8(0, 1, 2, 3, 5, 6, 7, 4, 10, 11, 8, 9, 15, 12, 13, 14));
+}
+
+/// InvShiftRows as a single shuffle: row r is rotated r positions to the right.
+SSSE3_TARGET static inline __m128i inv_shift_rows_vec(__m128i block) {
+    return _mm_shuffle_epi8(block, _mm_setr_epi8(0, 1, 2, 3, 7, 4, 5, 6, 10, 11, 8, 9, 13, 14, 15, 12));
+}
+
+/// Multiply all 16 bytes by x (i.e. 2) in Rijndael's finite field: shift left, and reduce the bytes whose top bit was set.
+SSSE3_TARGET static inline __m128i xtime_vec(__m128i block) {
+    __m128i overflow = _mm_cmplt_epi8(block, _mm_setzero_si128()); // 0xff where the top bit is set
+    return _mm_xor_si128(_mm_add_epi8(block, block), _mm_and_si128(overflow, _mm_set1_epi8(0x1b)));
+}
+
+/// MixColumns on all four columns at once. Since blocks are stored row by row, rotating the block by one row (4 bytes)
+/// lines up every byte with the one below it in its column, so row r becomes 2 * a_r ^ 3 * a_r+1 ^ a_r+2 ^ a_r+3.
+SSSE3_TARGET static inline __m128i mix_columns_vec(__m128i block) {
+    __m128i rot1 = _mm_shuffle_epi32(block, 0x39);
+    __m128i rot2 = _mm_shuffle_epi32(block, 0x4e);
+    __m128i rot3 = _mm_shuffle_epi32(block, 0x93);
+    return _mm_xor_si128(_mm_xor_si128(xtime_vec(_mm_xor_si128(block, rot1)), rot1), _mm_xor_si128(rot2, rot3));
+}
+
+/// InvMixColumns, using that the inverse matrix equals the forward one times (5, 0, 4, 0): first add 4 * (a_r ^ a_r+2) to every row, then apply MixColumns.
+SSSE3_TARGET static inline __m128i inv_mix_columns_vec(__m128i block) {
+    __m128i u = xtime_vec(xtime_vec(_mm_xor_si128(block, _mm_shuffle_epi32(block, 0x4e))));
+    return mix_columns_vec(_mm_xor_si128(block, u));
+}
+
+#pragma endregion
+
+#pragma region Engines
+
+/// Encrypt blocks with the SIMD round functions, with the same round structure as encrypt_block.
+SSSE3_TARGET void aes_ssse3_encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds) {
+    __m128i s_box[16];
+    load_s_box(s_box, SBox);
+
+    __m128i keys[MAX_ROUNDS + 1];
+    for (size_t r = 0; r <= rounds; r++) {
+        keys[r] = _mm_loadu_si128((const __m128i*) &round_keys[r * BLOCK_SIZE]);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &in[i * BLOCK_SIZE]), keys[0]);
+        for (size_t r = 1; r <= rounds; r++) {
+            b = shift_rows_vec(sub_bytes_vec(b, s_box));
+            if (r != rounds) {
+                b = mix_columns_vec(b);
+            }
+            b = _mm_xor_si128(b, keys[r]);
+        }
+        _mm_storeu_si128((__m128i*) &out[i * BLOCK_SIZE], b);
+    }
+}
+
+/// Decrypt blocks encrypted with the same round keys, by running the inverse rounds in reverse order.
+SSSE3_TARGET void aes_ssse3_decrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds) {
+    __m128i inv_s_box[16];
+    load_s_box(inv_s_box, InverseSBox);
+
+    __m128i keys[MAX_ROUNDS + 1];
+    for (size_t r = 0; r <= rounds; r++) {
+        keys[r] = _mm_loadu_si128((const __m128i*) &round_keys[r * BLOCK_SIZE]);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        __m128i b = _mm_loadu_si128((const __m128i*) &in[i * BLOCK_SIZE]);
+        for (size_t r = rounds; r >= 1; r--) {
+            b = _mm_xor_si128(b, keys[r]);
+            if (r != rounds) {
+                b = inv_mix_columns_vec(b);
+            }
+            b = sub_bytes_vec(inv_shift_rows_vec(b), inv_s_box);
+        }
+        _mm_storeu_si128((__m128i*) &out[i * BLOCK_SIZE], _mm_xor_si128(b, keys[0]));
+    }
+}
+
+/// Key guessing with the partial decryption of the last round done for all 16 positions at once: for each guess,
+/// every block has the guess removed and the inverse S-Box applied to all of its bytes, and the results are XORed together.
+/// The bytes that end up 0 are the positions for which the guess is a candidate.
+SSSE3_TARGET void aes_ssse3_evaluate(const unsigned char* lambda, CandidateMask* masks) {
+    __m128i inv_s_box[16];
+    load_s_box(inv_s_box, InverseSBox);
+
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        mask_clear(&masks[pos]);
+    }
+
+    for (unsigned int guess = 0; guess < 256; guess++) {
+        __m128i key = _mm_set1_epi8((char) guess);
+        __m128i sum = _mm_setzero_si128();
+        for (size_t i = 0; i < SETS; i++) {
+            __m128i block = _mm_loadu_si128((const __m128i*) &lambda[i * BLOCK_SIZE]);
+            sum = _mm_xor_si128(sum, sub_bytes_vec(_mm_xor_si128(block, key), inv_s_box));
+        }
+
+        unsigned int balanced = _mm_movemask_epi8(_mm_cmpeq_epi8(sum, _mm_setzero_si128()));
+        for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+            if (balanced & (1u << pos)) {
+                mask_set(&masks[pos], guess);
+            }
+        }
+    }
+}
+
+/// Single-pass key guessing for all 16 positions (see guess_all_round_key_masks), with the sums for all 256 guesses kept in 16 vectors.
+/// Guesses 16j to 16j + 15 reverse an odd value v through row j ^ (v >> 4) of the inverse S-Box, with its entries permuted by v & 15,
+/// so each value costs 16 shuffles instead of 256 lookups.
+SSSE3_TARGET void aes_ssse3_evaluate_parity(const unsigned char* lambda, CandidateMask* masks) {
+    __m128i inv_s_box[16];
+    load_s_box(inv_s_box, InverseSBox);
+    const __m128i lanes = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    CandidateMask parity[BLOCK_SIZE];
+    lambda_set_parity(lambda, parity);
+
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        CandidateMask odd;
+        parity_odd_values(&parity[pos], &odd);
+
+        __m128i sums[16];
+        for (int j = 0; j < 16; j++) {
+            sums[j] = _mm_setzero_si128();
+        }
+
+        for (size_t w = 0; w < 4; w++) {
+            for (uint64_t bits = odd.bits[w]; bits != 0; bits &= bits - 1) {
+                unsigned int v = w * 64 + __builtin_ctzll(bits);
+                __m128i order = _mm_xor_si128(lanes, _mm_set1_epi8((char) (v & 15)));
+                for (unsigned int j = 0; j < 16; j++) {
+                    sums[j] = _mm_xor_si128(sums[j], _mm_shuffle_epi8(inv_s_box[j ^ (v >> 4)], order));
+                }
+            }
+        }
+
+        mask_clear(&masks[pos]);
+        for (unsigned int j = 0; j < 16; j++) {
+            uint64_t balanced = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(sums[j], _mm_setzero_si128()));
+            masks[pos].bits[j / 4] |= balanced << (16 * (j % 4));
+        }
+    }
+}
+
+#pragma endregion
+
+#else
+
+bool aes_ssse3_available(void) {
+    return false;
+}
+
+// Never selected, since the engine is not available
+void aes_ssse3_encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds) {
+    encrypt_blocks(out, in, n, round_keys, rounds);
+}
+
+/// Scalar inverse of a round, for the fallback of aes_ssse3_decrypt_blocks below.
+static void inverse_round(unsigned char* block, const unsigned char* key, bool last_round) {
+    xor_blocks(block, key, BLOCK_SIZE);
+    if (!last_round) {
+        for (size_t col = 0; col < 4; col++) {
+            unsigned char a0 = block[col], a1 = block[4 + col], a2 = block[8 + col], a3 = block[12 + col];
+            block[col] = MultiplyBy14[a0] ^ MultiplyBy11[a1] ^ MultiplyBy13[a2] ^ MultiplyBy9[a3];
+            block[4 + col] = MultiplyBy9[a0] ^ MultiplyBy14[a1] ^ MultiplyBy11[a2] ^ MultiplyBy13[a3];
+            block[8 + col] = MultiplyBy13[a0] ^ MultiplyBy9[a1] ^ MultiplyBy14[a2] ^ MultiplyBy11[a3];
+            block[12 + col] = MultiplyBy11[a0] ^ MultiplyBy13[a1] ^ MultiplyBy9[a2] ^ MultiplyBy14[a3];
+        }
+    }
+
+    unsigned char shifted[BLOCK_SIZE];
+    for (size_t row = 0; row < 4; row++) {
+        for (size_t col = 0; col < 4; col++) {
+            shifted[row * 4 + (col + row) % 4] = InverseSBox[block[row * 4 + col]];
+        }
+    }
+    memcpy(block, shifted, BLOCK_SIZE);
+}
+
+// Only reached through the engine registry if the engine is available, but kept correct so the function can be called directly
+void aes_ssse3_decrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds) {
+    for (size_t i = 0; i < n; i++) {
+        unsigned char* block = &out[i * BLOCK_SIZE];
+        memmove(block, &in[i * BLOCK_SIZE], BLOCK_SIZE);
+        for (size_t r = rounds; r >= 1; r--) {
+            inverse_round(block, &round_keys[r * BLOCK_SIZE], r == rounds);
+        }
+        xor_blocks(block, round_keys, BLOCK_SIZE);
+    }
+}
+
+void aes_ssse3_evaluate(const unsigned char* lambda, CandidateMask* masks) {
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        guess_round_key_mask(lambda, pos, &masks[pos]);
+    }
+}
+
+void aes_ssse3_evaluate_parity(const unsigned char* lambda, CandidateMask* masks) {
+    guess_all_round_key_masks(lambda, masks);
+}
+
+#endif
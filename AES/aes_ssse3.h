@@ -0,0 +1,15 @@
+#ifndef INC_02255_HW1_GROUP33_AES_SSSE3_H
+#define INC_02255_HW1_GROUP33_AES_SSSE3_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "../SquareAttack/square.h"
+
+bool aes_ssse3_available(void);
+void aes_ssse3_encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds);
+void aes_ssse3_decrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds);
+void aes_ssse3_evaluate(const unsigned char* lambda, CandidateMask* masks);
+void aes_ssse3_evaluate_parity(const unsigned char* lambda, CandidateMask* masks);
+
+#endif //INC_02255_HW1_GROUP33_AES_SSSE3_H
@@ -0,0 +1,79 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ctr.h"
+#include "../Helpers/helpers.h"
+
+#define CTR_BATCH 64 // Keystream blocks generated per call to the engine, small enough to stay in the L1 cache
+
+/// Position of byte i of a standard (column by column) AES block in the row-by-row blocks of the engines.
+#define ROW_MAJOR(i) (((i) % 4) * 4 + (i) / 4)
+
+/// Write the counter block for the given block index into block, by adding the index to the IV as a big-endian 128-bit number.
+/// The IV is in the standard AES byte order, and the counter block is written row by row, ready to be encrypted.
+static void counter_block(unsigned char* block, const unsigned char* iv, uint64_t index) {
+    unsigned int carry = 0;
+    for (size_t i = BLOCK_SIZE; i > 0; i--) {
+        unsigned int sum = iv[i - 1] + (unsigned int) (index & 0xff) + carry;
+        block[ROW_MAJOR(i - 1)] = sum & 0xff;
+        carry = sum >> 8;
+        index >>= 8;
+    }
+}
+
+/// Add one to a row-by-row counter block, as a big-endian 128-bit number in the standard byte order.
+static inline void increment_counter(unsigned char* block) {
+    for (size_t i = BLOCK_SIZE; i > 0 && ++block[ROW_MAJOR(i - 1)] == 0; i--);
+}
+
+/// XOR n bytes of keystream into out. The keystream blocks are row by row, and are transposed to the standard byte order on the way.
+static inline void xor_keystream(unsigned char* out, const unsigned char* in, const unsigned char* keystream, size_t n) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + BLOCK_SIZE <= n; i += BLOCK_SIZE) {
+        // Interleaving the bytes of the low and high halves twice turns the 4 rows of 4 bytes into 4 columns
+        __m128i k = _mm_loadu_si128((const __m128i*) &keystream[i]);
+        k = _mm_unpacklo_epi8(k, _mm_srli_si128(k, 8));
+        k = _mm_unpacklo_epi8(k, _mm_srli_si128(k, 8));
+        _mm_storeu_si128((__m128i*) &out[i], _mm_xor_si128(_mm_loadu_si128((const __m128i*) &in[i]), k));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = in[i] ^ keystream[i - i % BLOCK_SIZE + ROW_MAJOR(i % BLOCK_SIZE)];
+    }
+}
+
+/// Encrypt or decrypt len bytes in counter mode, starting at the given block index of the keystream.
+/// Splitting a buffer at block boundaries and passing the index of each part's first block gives the same result as a single call,
+/// which is what allows several threads to work on one buffer. The keystream is XORed from in directly into out.
+/// The IV, the counter and the keystream are in the standard AES byte order, and are only transposed into and out of the row-by-row
+/// blocks of the engines. With 10 rounds this is standard AES-128-CTR, for the round keys of the key transposed with transpose_block.
+void ctr_crypt(EncryptBlocksFn encrypt, unsigned char* out, const unsigned char* in, size_t len,
+               const unsigned char* round_keys, size_t rounds, const unsigned char* iv, uint64_t first_block) {
+    unsigned char keystream[CTR_BATCH * BLOCK_SIZE];
+    unsigned char counter[BLOCK_SIZE];
+    counter_block(counter, iv, first_block);
+
+    while (len > 0) {
+        size_t blocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (blocks > CTR_BATCH) {
+            blocks = CTR_BATCH;
+        }
+
+        for (size_t b = 0; b < blocks; b++) {
+            memcpy(&keystream[b * BLOCK_SIZE], counter, BLOCK_SIZE);
+            increment_counter(counter);
+        }
+        encrypt(keystream, keystream, blocks, round_keys, rounds);
+
+        size_t n = blocks * BLOCK_SIZE < len ? blocks * BLOCK_SIZE : len;
+        xor_keystream(out, in, keystream, n);
+
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
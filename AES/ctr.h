@@ -0,0 +1,12 @@
+#ifndef INC_02255_HW1_GROUP33_CTR_H
+#define INC_02255_HW1_GROUP33_CTR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes.h"
+
+void ctr_crypt(EncryptBlocksFn encrypt, unsigned char* out, const unsigned char* in, size_t len,
+               const unsigned char* round_keys, size_t rounds, const unsigned char* iv, uint64_t first_block);
+
+#endif //INC_02255_HW1_GROUP33_CTR_H
@@ -0,0 +1,306 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "../AES/aes.h"
+#include "../AES/aes_ni.h"
+#include "../AES/aes_ssse3.h"
+#include "../Helpers/alloc_track.h"
+#include "../Helpers/helpers.h"
+
+#define THROUGHPUT_BLOCKS 4096 // Blocks per call when measuring encryption throughput
+#define THROUGHPUT_SECONDS 0.25 // Minimum time spent measuring each engine
+#define SELF_TEST_MAX_BLOCKS 64
+
+// Known answer from Appendix B of FIPS 197, stored row by row like all of our blocks. The key is the same as DEFAULT_CIPHER_KEY.
+static const unsigned char FIPS197_KEY[] = {0x2b, 0x28, 0xab, 0x09, 0x7e, 0xae, 0xf7, 0xcf,
+                                            0x15, 0xd2, 0x15, 0x4f, 0x16, 0xa6, 0x88, 0x3c};
+static const unsigned char FIPS197_PLAINTEXT[] = {0x32, 0x88, 0x31, 0xe0, 0x43, 0x5a, 0x31, 0x37,
+                                                  0xf6, 0x30, 0x98, 0x07, 0xa8, 0x8d, 0xa2, 0x34};
+static const unsigned char FIPS197_CIPHERTEXT[] = {0x39, 0x02, 0xdc, 0x19, 0x25, 0xdc, 0x11, 0x6a,
+                                                   0x84, 0x09, 0x85, 0x0b, 0x1d, 0xfb, 0x97, 0x32};
+static const size_t FIPS197_ROUNDS = 10;
+
+#pragma region Engines
+
+static bool always_available(void) {
+    return true;
+}
+
+/// The original implementation, which allocates a new block for every encryption.
+static void reference_encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds) {
+    for (size_t i = 0; i < n; i++) {
+        unsigned char* block = encrypt(&in[i * BLOCK_SIZE], round_keys, rounds);
+        memcpy(&out[i * BLOCK_SIZE], block, BLOCK_SIZE);
+        tracked_free(block);
+    }
+}
+
+/// The original implementation of the key guessing, one position at a time on a lambda set of separately allocated blocks.
+static void reference_evaluate(const unsigned char* lambda, CandidateMask* masks) {
+    unsigned char* blocks[SETS];
+    for (size_t i = 0; i < SETS; i++) {
+        blocks[i] = (unsigned char*) &lambda[i * BLOCK_SIZE];
+    }
+
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        size_t no_of_guesses;
+        unsigned char* guesses = guess_round_key(blocks, pos, &no_of_guesses);
+        mask_clear(&masks[pos]);
+        for (size_t i = 0; i < no_of_guesses; i++) {
+            mask_set(&masks[pos], guesses[i]);
+        }
+        tracked_free(guesses);
+    }
+}
+
+/// Allocation-free key guessing on a contiguous lambda set, one position at a time.
+static void portable_evaluate(const unsigned char* lambda, CandidateMask* masks) {
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        guess_round_key_mask(lambda, pos, &masks[pos]);
+    }
+}
+
+static const EncryptEngine ENCRYPT_ENGINES[] = {
+        {"reference", always_available, reference_encrypt_blocks, NULL},
+        {"portable", always_available, encrypt_blocks, NULL},
+        {"ssse3", aes_ssse3_available, aes_ssse3_encrypt_blocks, aes_ssse3_decrypt_blocks},
+        {"aesni", aes_ni_available, aes_ni_encrypt_blocks, NULL},
+};
+
+static const AnalysisEngine ANALYSIS_ENGINES[] = {
+        {"reference", always_available, reference_evaluate},
+        {"ssse3", aes_ssse3_available, aes_ssse3_evaluate},
+        {"portable", always_available, portable_evaluate},
+        {"parity", always_available, guess_all_round_key_masks},
+        {"parity-ssse3", aes_ssse3_available, aes_ssse3_evaluate_parity},
+};
+
+#pragma endregion
+
+#pragma region Selection
+
+/// Return all encrypt engines, including the ones that are not available on this CPU.
+const EncryptEngine* encrypt_engines(size_t* n) {
+    *n = sizeof(ENCRYPT_ENGINES) / sizeof(ENCRYPT_ENGINES[0]);
+    return ENCRYPT_ENGINES;
+}
+
+/// Return all analysis engines, including the ones that are not available on this CPU.
+const AnalysisEngine* analysis_engines(size_t* n) {
+    *n = sizeof(ANALYSIS_ENGINES) / sizeof(ANALYSIS_ENGINES[0]);
+    return ANALYSIS_ENGINES;
+}
+
+/// Select an encrypt engine by name. If name is NULL, the name is taken from the SQUARE_ENCRYPT_ENGINE environment variable,
+/// and if that is not set either, the fastest engine the CPU supports is used. Returns NULL if the engine does not exist or is not available.
+const EncryptEngine* select_encrypt_engine(const char* name) {
+    if (name == NULL) {
+        name = getenv(ENCRYPT_ENGINE_ENV);
+    }
+
+    size_t n;
+    const EncryptEngine* engines = encrypt_engines(&n);
+    for (size_t i = n; i > 0; i--) {
+        const EncryptEngine* engine = &engines[i - 1];
+        if ((name == NULL || strcmp(name, engine->name) == 0) && engine->available()) {
+            return engine;
+        }
+    }
+    return NULL;
+}
+
+/// Select an analysis engine by name, the same way select_encrypt_engine does, using the SQUARE_ANALYSIS_ENGINE environment variable.
+const AnalysisEngine* select_analysis_engine(const char* name) {
+    if (name == NULL) {
+        name = getenv(ANALYSIS_ENGINE_ENV);
+    }
+
+    size_t n;
+    const AnalysisEngine* engines = analysis_engines(&n);
+    for (size_t i = n; i > 0; i--) {
+        const AnalysisEngine* engine = &engines[i - 1];
+        if ((name == NULL || strcmp(name, engine->name) == 0) && engine->available()) {
+            return engine;
+        }
+    }
+    return NULL;
+}
+
+#pragma endregion
+
+#pragma region Self-test
+
+static double seconds_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/// Check an encrypt engine against the FIPS 197 vector and the reference implementation on random keys, blocks and round counts.
+/// If the engine can decrypt, decrypting its output has to give back the input.
+static size_t test_encrypt_engine(const EncryptEngine* engine, size_t iterations, uint64_t seed) {
+    size_t failures = 0;
+    unsigned char round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+    unsigned char block[BLOCK_SIZE];
+
+    expand_key(FIPS197_KEY, round_keys, FIPS197_ROUNDS);
+    engine->encrypt_blocks(block, FIPS197_PLAINTEXT, 1, round_keys, FIPS197_ROUNDS);
+    failures += memcmp(block, FIPS197_CIPHERTEXT, BLOCK_SIZE) != 0;
+
+    unsigned char key[BLOCK_SIZE];
+    unsigned char in[SELF_TEST_MAX_BLOCKS * BLOCK_SIZE], out[SELF_TEST_MAX_BLOCKS * BLOCK_SIZE], expected[SELF_TEST_MAX_BLOCKS * BLOCK_SIZE];
+    for (size_t it = 0; it < iterations; it++) {
+        fill_random(key, BLOCK_SIZE, &seed);
+        size_t rounds = 1 + next_random(&seed) % MAX_ROUNDS;
+        size_t n = 1 + next_random(&seed) % SELF_TEST_MAX_BLOCKS;
+        fill_random(in, n * BLOCK_SIZE, &seed);
+
+        expand_key(key, round_keys, rounds);
+        reference_encrypt_blocks(expected, in, n, round_keys, rounds);
+        engine->encrypt_blocks(out, in, n, round_keys, rounds);
+        failures += memcmp(out, expected, n * BLOCK_SIZE) != 0;
+
+        if (engine->decrypt_blocks != NULL) {
+            engine->decrypt_blocks(out, out, n, round_keys, rounds);
+            failures += memcmp(out, in, n * BLOCK_SIZE) != 0;
+        }
+    }
+    return failures;
+}
+
+/// Check an analysis engine against the reference key guessing on lambda sets encrypted with random keys.
+static size_t test_analysis_engine(const AnalysisEngine* engine, size_t iterations, uint64_t seed) {
+    size_t failures = 0;
+    unsigned char key[BLOCK_SIZE];
+    unsigned char round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+    unsigned char lambda[SETS * BLOCK_SIZE];
+    CandidateMask expected[BLOCK_SIZE], masks[BLOCK_SIZE];
+
+    for (size_t it = 0; it < iterations; it++) {
+        fill_random(key, BLOCK_SIZE, &seed);
+        size_t rounds = 1 + next_random(&seed) % 4; // The balance property only holds for 4 rounds, but the engines have to agree either way
+        expand_key(key, round_keys, rounds);
+        fill_lambda_set(lambda, next_random(&seed));
+        encrypt_blocks(lambda, lambda, SETS, round_keys, rounds);
+
+        reference_evaluate(lambda, expected);
+        engine->evaluate(lambda, masks);
+        failures += memcmp(masks, expected, sizeof(masks)) != 0;
+    }
+    return failures;
+}
+
+/// Measure how many bytes per second an encrypt engine encrypts with 4 rounds.
+static double encrypt_throughput(const EncryptEngine* engine, unsigned char* buf) {
+    unsigned char round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+    expand_key(FIPS197_KEY, round_keys, 4);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t calls = 0;
+    double elapsed;
+    do {
+        engine->encrypt_blocks(buf, buf, THROUGHPUT_BLOCKS, round_keys, 4);
+        calls++;
+    } while ((elapsed = seconds_since(&start)) < THROUGHPUT_SECONDS);
+
+    return (double) calls * THROUGHPUT_BLOCKS * BLOCK_SIZE / elapsed;
+}
+
+/// Measure how many lambda sets per second an analysis engine evaluates.
+static double analysis_throughput(const AnalysisEngine* engine) {
+    unsigned char lambda[SETS * BLOCK_SIZE];
+    CandidateMask masks[BLOCK_SIZE];
+    fill_lambda_set(lambda, 1);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t calls = 0;
+    double elapsed;
+    do {
+        engine->evaluate(lambda, masks);
+        calls++;
+        lambda[calls % (SETS * BLOCK_SIZE)] ^= masks[0].bits[0]; // Feed the result back so that the work cannot be skipped
+    } while ((elapsed = seconds_since(&start)) < THROUGHPUT_SECONDS);
+
+    return calls / elapsed;
+}
+
+/// Run the production path of the attack (generating, encrypting and analysing lambda sets) with every available engine
+/// except the reference ones, and check that it does not allocate any memory. Only possible with TRACK_ALLOCATIONS.
+static size_t test_steady_state_allocations(FILE* out) {
+    if (!alloc_tracking_enabled()) {
+        fprintf(out, "allocations  not tracked, configure with -DTRACK_ALLOCATIONS=ON to check them\n");
+        return 0;
+    }
+
+    unsigned char round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+    unsigned char lambda[SETS * BLOCK_SIZE];
+    CandidateMask masks[BLOCK_SIZE];
+    AttackContext ctx;
+    expand_key(FIPS197_KEY, round_keys, 4);
+    attack_init(&ctx, 4);
+
+    alloc_phase("steady state");
+    size_t n_encrypt, n_analysis;
+    const EncryptEngine* encrypt = encrypt_engines(&n_encrypt);
+    const AnalysisEngine* analysis = analysis_engines(&n_analysis);
+    for (size_t e = 0; e < n_encrypt; e++) {
+        for (size_t a = 0; a < n_analysis; a++) {
+            if (strcmp(encrypt[e].name, "reference") == 0 || strcmp(analysis[a].name, "reference") == 0
+                || !encrypt[e].available() || !analysis[a].available()) {
+                continue;
+            }
+            fill_lambda_set(lambda, e * n_analysis + a + 1);
+            encrypt[e].encrypt_blocks(lambda, lambda, SETS, round_keys, 4);
+            analysis[a].evaluate(lambda, masks);
+            attack_add_masks(&ctx, masks);
+            attack_add_lambda_sets(&ctx, analysis[a].evaluate, lambda, 1, 1);
+        }
+    }
+    alloc_phase("self-test");
+
+    uint64_t allocations = alloc_phase_allocations("steady state");
+    fprintf(out, "allocations  %-12s %-6s %10llu in steady state\n", "attack", allocations == 0 ? "ok" : "FAILED", (unsigned long long) allocations);
+    return allocations != 0;
+}
+
+/// Cross-check every available engine against the reference implementation, and print the results and throughput of each one to out.
+/// Returns the number of failed checks, so 0 means that all engines can be trusted.
+size_t engine_self_test(size_t iterations, FILE* out) {
+    size_t failures = 0;
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+    unsigned char* buf = tracked_calloc(THROUGHPUT_BLOCKS, BLOCK_SIZE);
+
+    size_t n;
+    const EncryptEngine* encrypt = encrypt_engines(&n);
+    for (size_t i = 0; i < n; i++) {
+        if (!encrypt[i].available()) {
+            fprintf(out, "encrypt  %-12s not supported by this CPU\n", encrypt[i].name);
+            continue;
+        }
+        size_t failed = test_encrypt_engine(&encrypt[i], iterations, seed);
+        fprintf(out, "encrypt  %-12s %-6s %10.1f MB/s\n", encrypt[i].name, failed == 0 ? "ok" : "FAILED", encrypt_throughput(&encrypt[i], buf) / 1e6);
+        failures += failed;
+    }
+
+    const AnalysisEngine* analysis = analysis_engines(&n);
+    for (size_t i = 0; i < n; i++) {
+        if (!analysis[i].available()) {
+            fprintf(out, "analysis %-12s not supported by this CPU\n", analysis[i].name);
+            continue;
+        }
+        size_t failed = test_analysis_engine(&analysis[i], iterations, seed);
+        fprintf(out, "analysis %-12s %-6s %10.1f sets/s\n", analysis[i].name, failed == 0 ? "ok" : "FAILED", analysis_throughput(&analysis[i]));
+        failures += failed;
+    }
+
+    tracked_free(buf);
+    return failures + test_steady_state_allocations(out);
+}
+
+#pragma endregion
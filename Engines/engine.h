@@ -0,0 +1,38 @@
+#ifndef INC_02255_HW1_GROUP33_ENGINE_H
+#define INC_02255_HW1_GROUP33_ENGINE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../AES/aes.h"
+#include "../SquareAttack/attack.h"
+#include "../SquareAttack/square.h"
+
+/// A named implementation of encrypt_blocks. The engines are listed from slowest to fastest.
+typedef struct {
+    const char* name;
+    bool (*available)(void); // Whether the CPU supports the engine
+    EncryptBlocksFn encrypt_blocks;
+    EncryptBlocksFn decrypt_blocks; // Inverse of encrypt_blocks, or NULL if the engine cannot decrypt
+} EncryptEngine;
+
+/// A named implementation of the key guessing, which evaluates an encrypted lambda set (SETS consecutive blocks)
+/// for all BLOCK_SIZE positions of the last round key at once. The engines are listed from slowest to fastest.
+typedef struct {
+    const char* name;
+    bool (*available)(void);
+    EvaluateFn evaluate;
+} AnalysisEngine;
+
+#define ENCRYPT_ENGINE_ENV "SQUARE_ENCRYPT_ENGINE"
+#define ANALYSIS_ENGINE_ENV "SQUARE_ANALYSIS_ENGINE"
+
+const EncryptEngine* encrypt_engines(size_t* n);
+const EncryptEngine* select_encrypt_engine(const char* name);
+const AnalysisEngine* analysis_engines(size_t* n);
+const AnalysisEngine* select_analysis_engine(const char* name);
+
+size_t engine_self_test(size_t iterations, FILE* out);
+
+#endif //INC_02255_HW1_GROUP33_ENGINE_H
@@ -0,0 +1,198 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "alloc_track.h"
+
+/// Statistics of a single call site.
+typedef struct {
+    const char* file;
+    int line;
+    uint64_t count[ALLOC_MAX_PHASES]; // Allocations made in each phase
+    uint64_t bytes[ALLOC_MAX_PHASES];
+    int64_t live_count; // Allocations that have not been freed yet, over all phases
+    int64_t live_bytes;
+} AllocSite;
+
+/// Stored in front of every tracked allocation, so that track_free knows where it came from and how large it was.
+/// Its size keeps the memory handed out aligned like the one from malloc.
+typedef union {
+    struct {
+        size_t site;
+        size_t size;
+    };
+    max_align_t align;
+} AllocHeader;
+
+// Tracking is a process-wide debugging aid, so unlike the rest of the library it keeps global state, guarded by a mutex
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static AllocSite sites[ALLOC_MAX_SITES];
+static size_t n_sites = 0;
+static const char* phases[ALLOC_MAX_PHASES] = {"startup"};
+static size_t n_phases = 1;
+static size_t current_phase = 0;
+
+#ifdef TRACK_ALLOCATIONS
+/// Find the index of a phase by name, or return ALLOC_MAX_PHASES if there is none. Has to be called with the lock held.
+static size_t find_phase(const char* name) {
+    for (size_t i = 0; i < n_phases; i++) {
+        if (strcmp(phases[i], name) == 0) {
+            return i;
+        }
+    }
+    return ALLOC_MAX_PHASES;
+}
+#endif
+
+/// Find or add the entry of a call site. Sites past ALLOC_MAX_SITES all share the last entry. Has to be called with the lock held.
+static size_t find_site(const char* file, int line) {
+    for (size_t i = 0; i < n_sites; i++) {
+        if (sites[i].line == line && strcmp(sites[i].file, file) == 0) {
+            return i;
+        }
+    }
+    if (n_sites == ALLOC_MAX_SITES) {
+        return ALLOC_MAX_SITES - 1;
+    }
+    sites[n_sites].file = file;
+    sites[n_sites].line = line;
+    return n_sites++;
+}
+
+/// Record an allocation of the given size, and return the pointer handed out to the caller.
+static void* record(AllocHeader* header, size_t size, const char* file, int line) {
+    if (header == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+    size_t site = find_site(file, line);
+    sites[site].count[current_phase]++;
+    sites[site].bytes[current_phase] += size;
+    sites[site].live_count++;
+    sites[site].live_bytes += size;
+    pthread_mutex_unlock(&lock);
+
+    header->site = site;
+    header->size = size;
+    return header + 1;
+}
+
+/// Record that an allocation is no longer live.
+static void forget(const AllocHeader* header) {
+    pthread_mutex_lock(&lock);
+    sites[header->site].live_count--;
+    sites[header->site].live_bytes -= header->size;
+    pthread_mutex_unlock(&lock);
+}
+
+void* track_malloc(size_t size, const char* file, int line) {
+    return record(malloc(sizeof(AllocHeader) + size), size, file, line);
+}
+
+void* track_calloc(size_t n, size_t size, const char* file, int line) {
+    if (size != 0 && n > (SIZE_MAX - sizeof(AllocHeader)) / size) {
+        return NULL;
+    }
+    return record(calloc(1, sizeof(AllocHeader) + n * size), n * size, file, line);
+}
+
+/// A reallocation counts as freeing the old block and allocating a new one at the call site of the realloc.
+void* track_realloc(void* ptr, size_t size, const char* file, int line) {
+    if (ptr == NULL) {
+        return track_malloc(size, file, line);
+    }
+
+    AllocHeader* header = (AllocHeader*) ptr - 1;
+    AllocHeader old = *header;
+    AllocHeader* moved = realloc(header, sizeof(AllocHeader) + size);
+    if (moved == NULL) {
+        return NULL; // The old block is still valid and still tracked
+    }
+    forget(&old);
+    return record(moved, size, file, line);
+}
+
+void track_free(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    AllocHeader* header = (AllocHeader*) ptr - 1;
+    forget(header);
+    free(header);
+}
+
+/// Whether the project was compiled with TRACK_ALLOCATIONS.
+bool alloc_tracking_enabled(void) {
+#ifdef TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// Attribute all following allocations to the named phase, until the next call. The name has to stay valid until the report.
+/// Does nothing without TRACK_ALLOCATIONS.
+/// Phases past ALLOC_MAX_PHASES are merged into the last one.
+void alloc_phase(const char* name) {
+#ifdef TRACK_ALLOCATIONS
+    pthread_mutex_lock(&lock);
+    size_t phase = find_phase(name);
+    if (phase == ALLOC_MAX_PHASES) {
+        phase = n_phases < ALLOC_MAX_PHASES ? n_phases++ : ALLOC_MAX_PHASES - 1;
+        phases[phase] = name;
+    }
+    current_phase = phase;
+    pthread_mutex_unlock(&lock);
+#else
+    (void) name;
+#endif
+}
+
+/// Number of allocations made in the named phase, over all call sites. Always 0 without TRACK_ALLOCATIONS.
+uint64_t alloc_phase_allocations(const char* name) {
+    uint64_t total = 0;
+#ifdef TRACK_ALLOCATIONS
+    pthread_mutex_lock(&lock);
+    size_t phase = find_phase(name);
+    for (size_t i = 0; phase != ALLOC_MAX_PHASES && i < n_sites; i++) {
+        total += sites[i].count[phase];
+    }
+    pthread_mutex_unlock(&lock);
+#else
+    (void) name;
+#endif
+    return total;
+}
+
+/// Print the allocations of every phase by call site, followed by the memory that is still live.
+void alloc_report(FILE* out) {
+    if (!alloc_tracking_enabled()) {
+        fprintf(out, "Allocation tracking is disabled, configure with -DTRACK_ALLOCATIONS=ON to enable it.\n");
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    for (size_t p = 0; p < n_phases; p++) {
+        uint64_t count = 0, bytes = 0;
+        for (size_t i = 0; i < n_sites; i++) {
+            count += sites[i].count[p];
+            bytes += sites[i].bytes[p];
+        }
+        fprintf(out, "Phase %-12s %10llu allocations %12llu bytes\n", phases[p], (unsigned long long) count, (unsigned long long) bytes);
+        for (size_t i = 0; i < n_sites; i++) {
+            if (sites[i].count[p] > 0) {
+                fprintf(out, "    %s:%-5d %10llu allocations %12llu bytes\n", sites[i].file, sites[i].line,
+                        (unsigned long long) sites[i].count[p], (unsigned long long) sites[i].bytes[p]);
+            }
+        }
+    }
+
+    fprintf(out, "Still live:\n");
+    for (size_t i = 0; i < n_sites; i++) {
+        if (sites[i].live_count > 0) {
+            fprintf(out, "    %s:%-5d %10lld allocations %12lld bytes\n", sites[i].file, sites[i].line,
+                    (long long) sites[i].live_count, (long long) sites[i].live_bytes);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
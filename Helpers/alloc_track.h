@@ -0,0 +1,41 @@
+#ifndef INC_02255_HW1_GROUP33_ALLOC_TRACK_H
+#define INC_02255_HW1_GROUP33_ALLOC_TRACK_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Allocation accounting, switched on at compile time with TRACK_ALLOCATIONS (the CMake option of the same name).
+// All allocations of this project go through the tracked_* macros, which record the count, bytes and live bytes of every call site,
+// split by the phase of the program that was active when the allocation was made. Without TRACK_ALLOCATIONS, the macros are plain
+// malloc and free, and the phase functions compile to nothing that takes a lock or touches the tables.
+// Memory from tracked_malloc, tracked_calloc and tracked_realloc must only be released with tracked_free.
+
+#define ALLOC_MAX_SITES 256
+#define ALLOC_MAX_PHASES 16
+
+#ifdef TRACK_ALLOCATIONS
+#define tracked_malloc(size) track_malloc((size), __FILE__, __LINE__)
+#define tracked_calloc(n, size) track_calloc((n), (size), __FILE__, __LINE__)
+#define tracked_realloc(ptr, size) track_realloc((ptr), (size), __FILE__, __LINE__)
+#define tracked_free(ptr) track_free(ptr)
+#else
+#define tracked_malloc(size) malloc(size)
+#define tracked_calloc(n, size) calloc((n), (size))
+#define tracked_realloc(ptr, size) realloc((ptr), (size))
+#define tracked_free(ptr) free(ptr)
+#endif
+
+void* track_malloc(size_t size, const char* file, int line);
+void* track_calloc(size_t n, size_t size, const char* file, int line);
+void* track_realloc(void* ptr, size_t size, const char* file, int line);
+void track_free(void* ptr);
+
+bool alloc_tracking_enabled(void);
+void alloc_phase(const char* name);
+uint64_t alloc_phase_allocations(const char* name);
+void alloc_report(FILE* out);
+
+#endif //INC_02255_HW1_GROUP33_ALLOC_TRACK_H
@@ -1,14 +1,13 @@
-#include <malloc.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "alloc_track.h"
 #include "helpers.h"
 
-const size_t BLOCK_SIZE = 16;
-
 /// Reads a 32-char long hex string into a 4x4 block, reading row by row (not column by column!)
 unsigned char* block_from_string(const char* string) {
-    unsigned char* block = malloc(BLOCK_SIZE);
+    unsigned char* block = tracked_malloc(BLOCK_SIZE);
     for (size_t i = 0; i < BLOCK_SIZE; i++) {
         char sub_string[2], *ptr = sub_string;
         memcpy(sub_string, &string[i * 2], 2);
@@ -18,10 +17,37 @@ unsigned char* block_from_string(const char* string) {
     return block;
 }
 
+/// Parse a 32-char hex string into a block, reading row by row like block_from_string, without allocating.
+/// Returns false and leaves the block unchanged if the string has the wrong length or contains anything but hex digits.
+bool parse_block(const char* string, unsigned char* block) {
+    if (strlen(string) != BLOCK_SIZE * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < BLOCK_SIZE * 2; i++) {
+        if (!isxdigit((unsigned char) string[i])) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        sscanf(&string[i * 2], "%2hhx", &block[i]);
+    }
+    return true;
+}
+
+/// Transpose a block between the row-by-row layout used here and the standard column-by-column byte order of AES. In and out must differ.
+void transpose_block(unsigned char* out, const unsigned char* in) {
+    for (size_t row = 0; row < 4; row++) {
+        for (size_t col = 0; col < 4; col++) {
+            out[row * 4 + col] = in[col * 4 + row];
+        }
+    }
+}
+
 /// Helper function to create a string with a single parameter in it.
 /// Source: https://stackoverflow.com/a/5172154/2102106
 char* format_str(char* format, size_t param) {
-    char* buf = malloc(256);
+    char* buf = tracked_malloc(256);
     snprintf(buf, 256, format, param);
     return buf;
 }
@@ -52,11 +78,32 @@ void swap_values(unsigned char* block, int i1, int i2) {
     block[i2] = tmp;
 }
 
-/// Generate a 4x4 block with semi-random values
-unsigned char* generate_block(unsigned int seed) {
-    unsigned char* block = malloc(sizeof(unsigned char) * BLOCK_SIZE);
+/// Fill a caller-provided 4x4 block with semi-random values
+void fill_block(unsigned char* block, unsigned int seed) {
     for (size_t i = 0; i < BLOCK_SIZE; i++) {
         block[i] = i * seed % 256; // The value should be dependent on the round number so that each lambda set is different
     }
+}
+
+/// Generate a 4x4 block with semi-random values
+unsigned char* generate_block(unsigned int seed) {
+    unsigned char* block = tracked_malloc(sizeof(unsigned char) * BLOCK_SIZE);
+    fill_block(block, seed);
     return block;
 }
+
+/// Small xorshift generator. The state is owned by the caller, so unlike rand it can be used from several threads at once.
+/// The state must not be 0.
+uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/// Fill a buffer with random bytes from next_random.
+void fill_random(unsigned char* buf, size_t n, uint64_t* state) {
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = next_random(state) >> 56;
+    }
+}
@@ -1,16 +1,24 @@
 #ifndef INC_02255_HW1_GROUP33_HELPERS_H
 #define INC_02255_HW1_GROUP33_HELPERS_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
-extern const size_t BLOCK_SIZE;
+#define BLOCK_SIZE 16 // Size of an AES block and key in bytes
 
 unsigned char* block_from_string(const char* string);
+bool parse_block(const char* string, unsigned char* block);
+void transpose_block(unsigned char* out, const unsigned char* in);
 char* format_str(char* format, size_t param);
 void print(const unsigned char* block);
 void print_with_msg(const unsigned char* block, const char* msg);
 
 void swap_values(unsigned char* block, int i1, int i2);
+void fill_block(unsigned char* block, unsigned int seed);
 unsigned char* generate_block(unsigned int seed);
 
+uint64_t next_random(uint64_t* state);
+void fill_random(unsigned char* buf, size_t n, uint64_t* state);
+
 #endif //INC_02255_HW1_GROUP33_HELPERS_H
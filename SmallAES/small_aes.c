@@ -0,0 +1,278 @@
+#include <string.h>
+
+#include "small_aes.h"
+#include "../AES/constants.h"
+#include "../Helpers/helpers.h"
+
+#pragma region Field and S-Box
+
+#if SAES_WORD_BITS == 4
+#define SAES_POLYNOMIAL 0x13 // x^4 + x + 1
+
+// Inversion in GF(2^4) followed by the affine map of the small scale variants
+static const unsigned char SmallSBox[16] = {
+        0x6, 0xb, 0x5, 0x4, 0x2, 0xe, 0x7, 0xa, 0x9, 0xd, 0xf, 0xc, 0x3, 0x1, 0x0, 0x8
+};
+static const unsigned char SmallInverseSBox[16] = {
+        0xe, 0xd, 0x4, 0xc, 0x3, 0x2, 0x0, 0x6, 0xf, 0x8, 0x7, 0x1, 0xb, 0x9, 0x5, 0xa
+};
+#define SAES_SBOX SmallSBox
+#define SAES_INVERSE_SBOX SmallInverseSBox
+#else
+#define SAES_POLYNOMIAL 0x11b // x^8 + x^4 + x^3 + x + 1
+#define SAES_SBOX SBox
+#define SAES_INVERSE_SBOX InverseSBox
+#endif
+
+/// Multiply a word by x in GF(2^e).
+static unsigned char xtime(unsigned char a) {
+    unsigned int r = (unsigned int) a << 1;
+    if (r & SAES_VALUES) {
+        r ^= SAES_POLYNOMIAL;
+    }
+    return (unsigned char) r;
+}
+
+/// Round constant x^round in GF(2^e), for the derivation of round key round + 1.
+static unsigned char round_constant(size_t round) {
+    unsigned char r = 1;
+    for (size_t i = 0; i < round; i++) {
+        r = xtime(r);
+    }
+    return r;
+}
+
+#pragma endregion
+
+#pragma region Key schedule
+
+/// Derive the next round key from the current one. Column 0 is XORed with the substituted last column, rotated up by one word,
+/// and with the round constant in the top row. Every other column is XORed with the new column to its left.
+void saes_derive_next_key(unsigned char* key, size_t round) {
+    unsigned char word[SAES_ROWS];
+    for (size_t row = 0; row < SAES_ROWS; row++) {
+        word[row] = SAES_SBOX[key[((row + 1) % SAES_ROWS) * SAES_COLS + SAES_COLS - 1]];
+    }
+    word[0] ^= round_constant(round);
+
+    for (size_t row = 0; row < SAES_ROWS; row++) {
+        key[row * SAES_COLS] ^= word[row];
+        for (size_t col = 1; col < SAES_COLS; col++) {
+            key[row * SAES_COLS + col] ^= key[row * SAES_COLS + col - 1];
+        }
+    }
+}
+
+/// Derive the previous round key from a given key, by reversing the operations performed in saes_derive_next_key.
+void saes_derive_previous_key(unsigned char* key, size_t round) {
+    for (size_t row = 0; row < SAES_ROWS; row++) {
+        for (size_t col = SAES_COLS - 1; col > 0; col--) {
+            key[row * SAES_COLS + col] ^= key[row * SAES_COLS + col - 1];
+        }
+    }
+
+    unsigned char word[SAES_ROWS];
+    for (size_t row = 0; row < SAES_ROWS; row++) {
+        word[row] = SAES_SBOX[key[((row + 1) % SAES_ROWS) * SAES_COLS + SAES_COLS - 1]];
+    }
+    word[0] ^= round_constant(round);
+
+    for (size_t row = 0; row < SAES_ROWS; row++) {
+        key[row * SAES_COLS] ^= word[row];
+    }
+}
+
+/// Write the key followed by the round keys for the given number of rounds into round_keys, (rounds + 1) * SAES_WORDS bytes in total.
+void saes_expand_key(const unsigned char* key, unsigned char* round_keys, size_t rounds) {
+    memcpy(round_keys, key, SAES_WORDS);
+    for (size_t r = 1; r <= rounds; r++) {
+        memcpy(&round_keys[r * SAES_WORDS], &round_keys[(r - 1) * SAES_WORDS], SAES_WORDS);
+        saes_derive_next_key(&round_keys[r * SAES_WORDS], r - 1);
+    }
+}
+
+#pragma endregion
+
+#pragma region Encryption
+
+static void mix_column(unsigned char* block, size_t col) {
+#if SAES_ROWS == 2
+    unsigned char a = block[col], b = block[SAES_COLS + col];
+    unsigned char t = xtime(a ^ b); // [[x + 1, x], [x, x + 1]]
+    block[col] = a ^ t;
+    block[SAES_COLS + col] = b ^ t;
+#elif SAES_ROWS == 4
+    unsigned char a[4];
+    for (size_t row = 0; row < 4; row++) {
+        a[row] = block[row * SAES_COLS + col];
+    }
+    for (size_t row = 0; row < 4; row++) {
+        unsigned char b = a[(row + 1) % 4];
+        block[row * SAES_COLS + col] = xtime(a[row] ^ b) ^ b ^ a[(row + 2) % 4] ^ a[(row + 3) % 4]; // Circulant (x, x + 1, 1, 1)
+    }
+#else
+    (void) block;
+    (void) col; // A single row is not mixed
+#endif
+}
+
+/// Perform a round of the small scale variant. The last round omits MixColumns, as in perform_round.
+static void perform_small_round(unsigned char* block, const unsigned char* key, bool last_round) {
+    unsigned char shifted[SAES_WORDS];
+    for (size_t row = 0; row < SAES_ROWS; row++) {
+        for (size_t col = 0; col < SAES_COLS; col++) {
+            shifted[row * SAES_COLS + col] = SAES_SBOX[block[row * SAES_COLS + (col + row) % SAES_COLS]];
+        }
+    }
+    memcpy(block, shifted, SAES_WORDS);
+
+    if (!last_round) {
+        for (size_t col = 0; col < SAES_COLS; col++) {
+            mix_column(block, col);
+        }
+    }
+    for (size_t i = 0; i < SAES_WORDS; i++) {
+        block[i] ^= key[i];
+    }
+}
+
+/// Encrypt a single block with pre-expanded round keys. In and out may point to the same block.
+void saes_encrypt_block(unsigned char* out, const unsigned char* in, const unsigned char* round_keys, size_t rounds) {
+    for (size_t i = 0; i < SAES_WORDS; i++) {
+        out[i] = in[i] ^ round_keys[i];
+    }
+    for (size_t r = 1; r <= rounds; r++) {
+        perform_small_round(out, &round_keys[r * SAES_WORDS], r == rounds);
+    }
+}
+
+/// Encrypt n consecutive blocks with pre-expanded round keys. In and out may point to the same buffer.
+void saes_encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds) {
+    for (size_t i = 0; i < n; i++) {
+        saes_encrypt_block(&out[i * SAES_WORDS], &in[i * SAES_WORDS], round_keys, rounds);
+    }
+}
+
+#pragma endregion
+
+#pragma region Square Attack
+
+/// Fill lambda with SAES_VALUES blocks, in which the word at position active takes every value once and all other words
+/// are random constants drawn from state.
+void saes_fill_lambda_set(unsigned char* lambda, size_t active, uint64_t* state) {
+    unsigned char constants[SAES_WORDS];
+    for (size_t i = 0; i < SAES_WORDS; i++) {
+        constants[i] = (unsigned char) (next_random(state) >> 56) & (SAES_VALUES - 1);
+    }
+
+    for (size_t v = 0; v < SAES_VALUES; v++) {
+        memcpy(&lambda[v * SAES_WORDS], constants, SAES_WORDS);
+        lambda[v * SAES_WORDS + active] = (unsigned char) v;
+    }
+}
+
+/// Set masks[pos] to the guesses for every word of the last round key for which the encrypted lambda set is balanced
+/// one round before the end. Only values that occur an odd number of times in a position contribute to the XOR sum.
+void saes_guess_round_keys(const unsigned char* lambda, SmallMask* masks) {
+    for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+        bool odd[SAES_VALUES] = {false};
+        for (size_t v = 0; v < SAES_VALUES; v++) {
+            odd[lambda[v * SAES_WORDS + pos]] ^= true;
+        }
+        unsigned char values[SAES_VALUES];
+        size_t n_values = 0;
+        for (unsigned int c = 0; c < SAES_VALUES; c++) {
+            if (odd[c]) {
+                values[n_values++] = (unsigned char) c;
+            }
+        }
+
+        memset(&masks[pos], 0, sizeof(SmallMask));
+        for (unsigned int guess = 0; guess < SAES_VALUES; guess++) {
+            unsigned char sum = 0;
+            for (size_t i = 0; i < n_values; i++) {
+                sum ^= SAES_INVERSE_SBOX[values[i] ^ guess];
+            }
+            if (sum == 0) {
+                masks[pos].bits[guess >> 6] |= (uint64_t) 1 << (guess & 63);
+            }
+        }
+    }
+}
+
+size_t small_mask_count(const SmallMask* mask) {
+    size_t count = 0;
+    for (size_t i = 0; i < sizeof(mask->bits) / sizeof(mask->bits[0]); i++) {
+        count += __builtin_popcountll(mask->bits[i]);
+    }
+    return count;
+}
+
+/// Start an attack on the given number of rounds with every guess still possible for every word.
+void saes_attack_init(SmallAttack* attack, size_t rounds) {
+    attack->rounds = rounds;
+    attack->sets_used = 0;
+    for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+        memset(&attack->candidates[pos], 0, sizeof(SmallMask));
+        for (unsigned int v = 0; v < SAES_VALUES; v++) {
+            attack->candidates[pos].bits[v >> 6] |= (uint64_t) 1 << (v & 63);
+        }
+    }
+}
+
+/// Remove every guess that is not balanced for the given encrypted lambda set.
+void saes_attack_add_lambda_set(SmallAttack* attack, const unsigned char* encrypted_lambda) {
+    SmallMask masks[SAES_WORDS];
+    saes_guess_round_keys(encrypted_lambda, masks);
+    saes_attack_add_masks(attack, masks);
+}
+
+/// Intersect the candidates with the masks of one lambda set, as computed by saes_guess_round_keys.
+void saes_attack_add_masks(SmallAttack* attack, const SmallMask* masks) {
+    for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+        for (size_t i = 0; i < sizeof(masks[pos].bits) / sizeof(masks[pos].bits[0]); i++) {
+            attack->candidates[pos].bits[i] &= masks[pos].bits[i];
+        }
+    }
+    attack->sets_used++;
+}
+
+/// Number of candidates that are left over the correct one, summed over all positions.
+size_t saes_attack_wrong_candidates(const SmallAttack* attack) {
+    size_t wrong = 0;
+    for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+        size_t count = small_mask_count(&attack->candidates[pos]);
+        wrong += count > 0 ? count - 1 : 0;
+    }
+    return wrong;
+}
+
+bool saes_attack_is_complete(const SmallAttack* attack) {
+    for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+        if (small_mask_count(&attack->candidates[pos]) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Write the original key into key, by deriving the previous round keys from the last one. Returns false if the attack is not complete.
+bool saes_attack_recover_key(const SmallAttack* attack, unsigned char* key) {
+    if (!saes_attack_is_complete(attack)) {
+        return false;
+    }
+
+    for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+        for (unsigned int v = 0; v < SAES_VALUES; v++) {
+            if (attack->candidates[pos].bits[v >> 6] >> (v & 63) & 1) {
+                key[pos] = (unsigned char) v;
+            }
+        }
+    }
+    for (size_t round = attack->rounds; round > 0; round--) {
+        saes_derive_previous_key(key, round - 1);
+    }
+    return true;
+}
+
+#pragma endregion
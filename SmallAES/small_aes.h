@@ -0,0 +1,66 @@
+#ifndef INC_02255_HW1_GROUP33_SMALL_AES_H
+#define INC_02255_HW1_GROUP33_SMALL_AES_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Small scale variants of AES, SR(n, r, c, e) in the notation of Cid, Murphy and Robshaw: a state of r x c words of e bits.
+// The shape is fixed at compile time, so every variant is built as its own program (see add_small_square in CMakeLists.txt).
+// With 4 x 4 words of 8 bits this is exactly AES-128, except that the number of rounds is not limited by a table.
+#ifndef SAES_ROWS
+#define SAES_ROWS 2 // Number of rows of the state and key, 1, 2 or 4
+#endif
+#ifndef SAES_COLS
+#define SAES_COLS 2 // Number of columns of the state and key, 1, 2 or 4
+#endif
+#ifndef SAES_WORD_BITS
+#define SAES_WORD_BITS 4 // Size of a word in bits, 4 or 8
+#endif
+
+#if SAES_ROWS != 1 && SAES_ROWS != 2 && SAES_ROWS != 4
+#error "SAES_ROWS must be 1, 2 or 4"
+#endif
+#if SAES_COLS != 1 && SAES_COLS != 2 && SAES_COLS != 4
+#error "SAES_COLS must be 1, 2 or 4"
+#endif
+#if SAES_WORD_BITS != 4 && SAES_WORD_BITS != 8
+#error "SAES_WORD_BITS must be 4 or 8"
+#endif
+
+#define SAES_WORDS (SAES_ROWS * SAES_COLS) // Number of words in a block and key, stored one per byte, row by row
+#define SAES_VALUES (1 << SAES_WORD_BITS) // Number of values of a word, which is also the number of blocks in a lambda set
+#define SAES_KEY_BITS (SAES_WORDS * SAES_WORD_BITS)
+#define SAES_MAX_ROUNDS 10
+
+/// Set of candidates for a single key word, with one bit for each possible value.
+typedef struct {
+    uint64_t bits[(SAES_VALUES + 63) / 64];
+} SmallMask;
+
+/// State of a Square Attack on the small scale variant, the counterpart of AttackContext.
+typedef struct {
+    size_t rounds;
+    size_t sets_used;
+    SmallMask candidates[SAES_WORDS];
+} SmallAttack;
+
+void saes_derive_next_key(unsigned char* key, size_t round);
+void saes_derive_previous_key(unsigned char* key, size_t round);
+void saes_expand_key(const unsigned char* key, unsigned char* round_keys, size_t rounds);
+void saes_encrypt_block(unsigned char* out, const unsigned char* in, const unsigned char* round_keys, size_t rounds);
+void saes_encrypt_blocks(unsigned char* out, const unsigned char* in, size_t n, const unsigned char* round_keys, size_t rounds);
+
+void saes_fill_lambda_set(unsigned char* lambda, size_t active, uint64_t* state);
+void saes_guess_round_keys(const unsigned char* lambda, SmallMask* masks);
+
+void saes_attack_init(SmallAttack* attack, size_t rounds);
+void saes_attack_add_lambda_set(SmallAttack* attack, const unsigned char* encrypted_lambda);
+void saes_attack_add_masks(SmallAttack* attack, const SmallMask* masks);
+size_t saes_attack_wrong_candidates(const SmallAttack* attack);
+bool saes_attack_is_complete(const SmallAttack* attack);
+bool saes_attack_recover_key(const SmallAttack* attack, unsigned char* key);
+
+size_t small_mask_count(const SmallMask* mask);
+
+#endif //INC_02255_HW1_GROUP33_SMALL_AES_H
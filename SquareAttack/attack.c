@@ -0,0 +1,168 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "attack.h"
+#include "../AES/aes.h"
+
+#define MAX_THREADS 256
+
+/// A share of a batch of lambda sets, evaluated by one thread into its own masks.
+typedef struct {
+    pthread_t thread;
+    bool started;
+    EvaluateFn evaluate;
+    const unsigned char* lambdas;
+    size_t n;
+    CandidateMask masks[BLOCK_SIZE]; // Intersection of the guesses from all sets in the share
+} BatchShare;
+
+/// Prepare a context for an attack on the given number of rounds, where every key byte is still a candidate.
+void attack_init(AttackContext* ctx, size_t rounds) {
+    ctx->rounds = rounds;
+    ctx->sets_used = 0;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        mask_fill(&ctx->candidates[pos]);
+    }
+}
+
+/// Analyse one encrypted lambda set (SETS consecutive blocks), and remove all guesses for which it is not balanced.
+void attack_add_lambda_set(AttackContext* ctx, const unsigned char* encrypted_lambda) {
+    CandidateMask masks[BLOCK_SIZE];
+    guess_all_round_key_masks(encrypted_lambda, masks);
+    attack_add_masks(ctx, masks);
+}
+
+/// Intersect the candidates with the guesses for all positions from one lambda set, e.g. as computed by an analysis engine.
+void attack_add_masks(AttackContext* ctx, const CandidateMask* masks) {
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        mask_and(&ctx->candidates[pos], &masks[pos]);
+    }
+    ctx->sets_used++;
+}
+
+/// Evaluate all lambda sets in a share and intersect their guesses.
+static void* evaluate_share(void* arg) {
+    BatchShare* share = arg;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        mask_fill(&share->masks[pos]);
+    }
+
+    for (size_t i = 0; i < share->n; i++) {
+        CandidateMask masks[BLOCK_SIZE];
+        share->evaluate(&share->lambdas[i * SETS * BLOCK_SIZE], masks);
+        for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+            mask_and(&share->masks[pos], &masks[pos]);
+        }
+    }
+    return NULL;
+}
+
+/// Analyse a batch of n encrypted lambda sets stored one after another, spread over the given number of threads.
+/// Since the guesses of all sets are simply intersected, the result is the same as adding the sets one by one.
+void attack_add_lambda_sets(AttackContext* ctx, EvaluateFn evaluate, const unsigned char* lambdas, size_t n, size_t threads) {
+    if (n == 0) {
+        return; // Nothing to analyse
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (threads > n) {
+        threads = n;
+    }
+    if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+
+    // Sized to the threads actually used instead of MAX_THREADS, since callers may run this on a small thread stack
+    BatchShare shares[threads];
+    size_t offset = 0;
+    for (size_t t = 0; t < threads; t++) {
+        BatchShare* share = &shares[t];
+        share->evaluate = evaluate;
+        share->lambdas = &lambdas[offset * SETS * BLOCK_SIZE];
+        share->n = n / threads + (t < n % threads);
+        offset += share->n;
+
+        // The first share is evaluated on the calling thread, as are the ones for which no thread could be started
+        share->started = t > 0 && pthread_create(&share->thread, NULL, evaluate_share, share) == 0;
+        if (t > 0 && !share->started) {
+            evaluate_share(share);
+        }
+    }
+    evaluate_share(&shares[0]);
+
+    for (size_t t = 0; t < threads; t++) {
+        if (shares[t].started) {
+            pthread_join(shares[t].thread, NULL);
+        }
+        for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+            mask_and(&ctx->candidates[pos], &shares[t].masks[pos]);
+        }
+    }
+    ctx->sets_used += n;
+}
+
+/// Count the wrong guesses that are still left, assuming that the correct one is among the candidates for every position.
+size_t attack_wrong_candidates(const AttackContext* ctx) {
+    size_t wrong = 0;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        size_t count = mask_count(&ctx->candidates[pos]);
+        wrong += count > 0 ? count - 1 : 0;
+    }
+    return wrong;
+}
+
+/// Checks whether there is exactly one candidate left for every byte of the last round key.
+bool attack_is_complete(const AttackContext* ctx) {
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        if (mask_count(&ctx->candidates[pos]) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Write the remaining candidates for a byte position into values (room for 256 entries), and return how many there are.
+size_t attack_candidates(const AttackContext* ctx, size_t key_pos, unsigned char* values) {
+    return mask_to_array(&ctx->candidates[key_pos], values);
+}
+
+/// Compute the number of last round keys that can be built from the remaining candidates, if it is at most 2^max_bits.
+/// Returns false if it is larger, or if a position has no candidates left.
+bool attack_guess_space(const AttackContext* ctx, unsigned int max_bits, uint64_t* space) {
+    uint64_t product = 1;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        size_t count = mask_count(&ctx->candidates[pos]);
+        if (count == 0 || product > ((uint64_t) 1 << max_bits) / count) {
+            return false;
+        }
+        product *= count;
+    }
+
+    *space = product;
+    return true;
+}
+
+/// Write the last round key into key, if the attack is complete. Returns false otherwise.
+bool attack_last_round_key(const AttackContext* ctx, unsigned char* key) {
+    if (!attack_is_complete(ctx)) {
+        return false;
+    }
+
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        mask_to_array(&ctx->candidates[pos], &key[pos]); // Exactly one candidate, so only one byte is written
+    }
+    return true;
+}
+
+/// Write the original cipher key into key, by deriving the previous round keys from the last one. Returns false if the attack is not complete.
+bool attack_recover_key(const AttackContext* ctx, unsigned char* key) {
+    if (!attack_last_round_key(ctx, key)) {
+        return false;
+    }
+
+    for (size_t round = ctx->rounds; round > 0; round--) {
+        derive_previous_key(key, round - 1);
+    }
+    return true;
+}
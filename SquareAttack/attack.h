@@ -0,0 +1,34 @@
+#ifndef INC_02255_HW1_GROUP33_ATTACK_H
+#define INC_02255_HW1_GROUP33_ATTACK_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "square.h"
+#include "../Helpers/helpers.h"
+
+/// Signature of the key guessing of an analysis engine: evaluate one encrypted lambda set for all BLOCK_SIZE positions.
+typedef void (*EvaluateFn)(const unsigned char* lambda, CandidateMask* masks);
+
+/// State of a single Square Attack. It holds no pointers and does not allocate, so any number of attacks can run side by side,
+/// and a context can be copied or placed wherever the caller wants (stack, heap, shared memory).
+typedef struct {
+    size_t rounds;
+    size_t sets_used; // Number of encrypted lambda sets that have been analysed so far
+    CandidateMask candidates[BLOCK_SIZE]; // Remaining guesses for each byte of the last round key
+} AttackContext;
+
+void attack_init(AttackContext* ctx, size_t rounds);
+void attack_add_lambda_set(AttackContext* ctx, const unsigned char* encrypted_lambda);
+void attack_add_masks(AttackContext* ctx, const CandidateMask* masks);
+void attack_add_lambda_sets(AttackContext* ctx, EvaluateFn evaluate, const unsigned char* lambdas, size_t n, size_t threads);
+size_t attack_wrong_candidates(const AttackContext* ctx);
+bool attack_is_complete(const AttackContext* ctx);
+size_t attack_candidates(const AttackContext* ctx, size_t key_pos, unsigned char* values);
+bool attack_guess_space(const AttackContext* ctx, unsigned int max_bits, uint64_t* space);
+
+bool attack_last_round_key(const AttackContext* ctx, unsigned char* key);
+bool attack_recover_key(const AttackContext* ctx, unsigned char* key);
+
+#endif //INC_02255_HW1_GROUP33_ATTACK_H
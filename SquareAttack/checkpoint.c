@@ -0,0 +1,115 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+#define CHECKPOINT_VERSION 2
+
+static const char CHECKPOINT_MAGIC[8] = "SQCHKPT";
+
+/// FNV-1a hash over the sequence number and state of a slot, used to detect snapshots that were only partially written.
+static uint64_t slot_checksum(const CheckpointSlot* slot) {
+    uint64_t h = 14695981039346656037ULL;
+    const unsigned char* parts[] = {(const unsigned char*) &slot->sequence, (const unsigned char*) &slot->state};
+    const size_t sizes[] = {sizeof(slot->sequence), sizeof(slot->state)};
+    for (size_t p = 0; p < 2; p++) {
+        for (size_t i = 0; i < sizes[p]; i++) {
+            h = (h ^ parts[p][i]) * 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+/// Return the newest slot that was written completely, or NULL if there is none.
+static const CheckpointSlot* newest_slot(const CheckpointFile* file) {
+    const CheckpointSlot* newest = NULL;
+    for (size_t i = 0; i < 2; i++) {
+        const CheckpointSlot* slot = &file->slots[i];
+        if (slot->sequence != 0 && slot->checksum == slot_checksum(slot) && (newest == NULL || slot->sequence > newest->sequence)) {
+            newest = slot;
+        }
+    }
+    return newest;
+}
+
+/// Fingerprint the attacked oracle by encrypting a fixed probe block with the given round keys.
+void checkpoint_target(CheckpointTarget* target, EncryptBlocksFn encrypt_blocks, const unsigned char* round_keys, size_t rounds) {
+    unsigned char probe[BLOCK_SIZE];
+    fill_block(probe, 0xc0ffee); // Any block will do, as long as it never changes
+    memset(target, 0, sizeof(CheckpointTarget));
+    target->rounds = rounds;
+    encrypt_blocks(target->probe, probe, 1, round_keys, rounds);
+}
+
+/// Open or create a checkpoint file for the given target and map it into memory. Unless resume is set, any previous snapshots in it are discarded.
+/// Returns 0 on success, CHECKPOINT_OTHER_TARGET if resuming a file of another target, and CHECKPOINT_ERROR if the file cannot be opened
+/// or mapped, or is not a checkpoint file of this version.
+int checkpoint_open(Checkpoint* cp, const char* path, bool resume, const CheckpointTarget* target) {
+    cp->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (cp->fd < 0) {
+        return CHECKPOINT_ERROR;
+    }
+
+    off_t size = lseek(cp->fd, 0, SEEK_END);
+    bool fresh = !resume || size == 0;
+    if ((!fresh && size != sizeof(CheckpointFile)) || ftruncate(cp->fd, sizeof(CheckpointFile)) != 0) {
+        close(cp->fd);
+        return CHECKPOINT_ERROR;
+    }
+
+    cp->file = mmap(NULL, sizeof(CheckpointFile), PROT_READ | PROT_WRITE, MAP_SHARED, cp->fd, 0);
+    if (cp->file == MAP_FAILED) {
+        close(cp->fd);
+        return CHECKPOINT_ERROR;
+    }
+
+    if (fresh) {
+        memset(cp->file, 0, sizeof(CheckpointFile));
+        memcpy(cp->file->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        cp->file->version = CHECKPOINT_VERSION;
+        cp->file->target = *target;
+    } else if (memcmp(cp->file->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || cp->file->version != CHECKPOINT_VERSION) {
+        checkpoint_close(cp);
+        return CHECKPOINT_ERROR;
+    } else if (memcmp(&cp->file->target, target, sizeof(CheckpointTarget)) != 0) {
+        checkpoint_close(cp);
+        return CHECKPOINT_OTHER_TARGET;
+    }
+
+    const CheckpointSlot* newest = newest_slot(cp->file);
+    cp->sequence = newest != NULL ? newest->sequence : 0;
+    return 0;
+}
+
+/// Copy the newest complete snapshot into state. Returns false if the file does not contain one yet.
+bool checkpoint_load(const Checkpoint* cp, CheckpointState* state) {
+    const CheckpointSlot* newest = newest_slot(cp->file);
+    if (newest == NULL) {
+        return false;
+    }
+
+    memcpy(state, &newest->state, sizeof(CheckpointState));
+    return true;
+}
+
+/// Write a snapshot into the slot that does not hold the newest one, so that a crash in the middle of it leaves the previous snapshot intact.
+/// The file is flushed asynchronously, so this is only a memcpy and never waits for the disk.
+void checkpoint_save(Checkpoint* cp, const CheckpointState* state) {
+    CheckpointSlot* slot = &cp->file->slots[(cp->sequence + 1) % 2];
+
+    slot->sequence = 0; // Invalidate the slot while it is being written
+    memcpy(&slot->state, state, sizeof(CheckpointState));
+    slot->sequence = ++cp->sequence;
+    slot->checksum = slot_checksum(slot);
+
+    msync(cp->file, sizeof(CheckpointFile), MS_ASYNC);
+}
+
+/// Flush and unmap the checkpoint file.
+void checkpoint_close(Checkpoint* cp) {
+    msync(cp->file, sizeof(CheckpointFile), MS_SYNC);
+    munmap(cp->file, sizeof(CheckpointFile));
+    close(cp->fd);
+}
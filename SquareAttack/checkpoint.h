@@ -0,0 +1,62 @@
+#ifndef INC_02255_HW1_GROUP33_CHECKPOINT_H
+#define INC_02255_HW1_GROUP33_CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "attack.h"
+#include "shard.h"
+#include "../AES/aes.h"
+
+/// Everything needed to continue an attack where it was stopped.
+typedef struct {
+    AttackContext ctx; // Candidate masks, and number of lambda sets analysed
+    uint64_t seeds_used; // Lambda sets are generated from the seeds 1 to seeds_used, so the next one uses seeds_used + 1
+    uint64_t corpus_offset; // Number of encrypted blocks consumed from the oracle
+
+    uint64_t space; // Size of the guess space being verified by the workers, or 0 if verification has not started
+    size_t found; // Number of keys in found_keys
+    unsigned char found_keys[SHARD_MAX_RESULTS][BLOCK_SIZE];
+    unsigned char shard_done[SHARD_COUNT];
+} CheckpointState;
+
+/// Identifies the attack a checkpoint belongs to: the number of rounds, and the oracle's ciphertext of a fixed probe block,
+/// which differs between keys. A checkpoint is only resumed for the same target.
+typedef struct {
+    uint64_t rounds;
+    unsigned char probe[BLOCK_SIZE];
+} CheckpointTarget;
+
+/// One of the two snapshots in the file. The sequence number tells which one is newer, and the checksum whether it was written completely.
+typedef struct {
+    uint64_t sequence; // 0 if the slot has never been written
+    uint64_t checksum;
+    CheckpointState state;
+} CheckpointSlot;
+
+/// Layout of a checkpoint file.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    CheckpointTarget target;
+    CheckpointSlot slots[2];
+} CheckpointFile;
+
+/// Handle to an open checkpoint file, mapped into memory.
+typedef struct {
+    int fd;
+    CheckpointFile* file;
+    uint64_t sequence; // Sequence number of the newest snapshot
+} Checkpoint;
+
+#define CHECKPOINT_ERROR (-1) // The file cannot be opened or mapped, or is not a checkpoint file of this version
+#define CHECKPOINT_OTHER_TARGET (-2) // The file belongs to another key or number of rounds
+
+void checkpoint_target(CheckpointTarget* target, EncryptBlocksFn encrypt_blocks, const unsigned char* round_keys, size_t rounds);
+int checkpoint_open(Checkpoint* cp, const char* path, bool resume, const CheckpointTarget* target);
+bool checkpoint_load(const Checkpoint* cp, CheckpointState* state);
+void checkpoint_save(Checkpoint* cp, const CheckpointState* state);
+void checkpoint_close(Checkpoint* cp);
+
+#endif //INC_02255_HW1_GROUP33_CHECKPOINT_H
@@ -0,0 +1,138 @@
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "integral.h"
+
+/// Number of blocks in a structure with the given active bytes.
+size_t structure_blocks(uint16_t active) {
+    return (size_t) 1 << (8 * __builtin_popcount(active));
+}
+
+/// Fill blocks with a structure: the active bytes run through all combinations of values, and all other bytes are taken from base.
+/// Generalises fill_lambda_set to any number and position of active bytes.
+void fill_structure(unsigned char* blocks, uint16_t active, const unsigned char* base) {
+    size_t positions[BLOCK_SIZE], k = 0;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        if (active & (1 << pos)) {
+            positions[k++] = pos;
+        }
+    }
+
+    size_t n = structure_blocks(active);
+    for (size_t i = 0; i < n; i++) {
+        unsigned char* block = &blocks[i * BLOCK_SIZE];
+        memcpy(block, base, BLOCK_SIZE);
+        for (size_t j = 0; j < k; j++) {
+            block[positions[j]] = i >> (8 * j);
+        }
+    }
+}
+
+/// XOR all n blocks together, and return a mask with bit i set if byte i of the sum is 0, i.e. if that byte is balanced.
+uint16_t balanced_bytes(const unsigned char* blocks, size_t n) {
+#if defined(__SSE2__)
+    __m128i sum[4] = {_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) { // Four independent accumulators, so that the loads are not serialised behind a single XOR chain
+        for (size_t l = 0; l < 4; l++) {
+            sum[l] = _mm_xor_si128(sum[l], _mm_loadu_si128((const __m128i*) &blocks[(i + l) * BLOCK_SIZE]));
+        }
+    }
+    for (; i < n; i++) {
+        sum[0] = _mm_xor_si128(sum[0], _mm_loadu_si128((const __m128i*) &blocks[i * BLOCK_SIZE]));
+    }
+
+    __m128i total = _mm_xor_si128(_mm_xor_si128(sum[0], sum[1]), _mm_xor_si128(sum[2], sum[3]));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(total, _mm_setzero_si128()));
+#else
+    uint64_t sum[2] = {0, 0};
+    for (size_t i = 0; i < n; i++) {
+        uint64_t words[2];
+        memcpy(words, &blocks[i * BLOCK_SIZE], BLOCK_SIZE);
+        sum[0] ^= words[0];
+        sum[1] ^= words[1];
+    }
+
+    unsigned char bytes[BLOCK_SIZE];
+    memcpy(bytes, sum, BLOCK_SIZE);
+    uint16_t mask = 0;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        mask |= (bytes[pos] == 0) << pos;
+    }
+    return mask;
+#endif
+}
+
+/// Prepare an empty pattern.
+void integral_init(IntegralPattern* pattern, uint16_t active, size_t rounds) {
+    memset(pattern, 0, sizeof(IntegralPattern));
+    pattern->active = active;
+    pattern->rounds = rounds;
+}
+
+/// Encrypt the given number of structures of a pattern, each with a random key and random constant bytes, and count the balanced output bytes.
+/// The buffer has to hold structure_blocks(pattern->active) blocks. Nothing is allocated, so this can run on many threads with their own buffers.
+void integral_evaluate(IntegralPattern* pattern, EncryptBlocksFn encrypt, size_t structures, unsigned char* buf, uint64_t* seed) {
+    size_t n = structure_blocks(pattern->active);
+    unsigned char key[BLOCK_SIZE], base[BLOCK_SIZE];
+    unsigned char round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+
+    for (size_t s = 0; s < structures; s++) {
+        fill_random(key, BLOCK_SIZE, seed);
+        fill_random(base, BLOCK_SIZE, seed);
+        expand_key(key, round_keys, pattern->rounds);
+
+        fill_structure(buf, pattern->active, base);
+        encrypt(buf, buf, n, round_keys, pattern->rounds);
+
+        uint16_t balanced = balanced_bytes(buf, n);
+        for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+            pattern->balanced[pos] += (balanced >> pos) & 1;
+        }
+    }
+    pattern->structures += structures;
+}
+
+/// Return a mask of the output bytes that were balanced in every structure, i.e. that most likely satisfy the integral property.
+uint16_t integral_always_balanced(const IntegralPattern* pattern) {
+    uint16_t mask = 0;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        if (pattern->structures > 0 && pattern->balanced[pos] == pattern->structures) {
+            mask |= 1 << pos;
+        }
+    }
+    return mask;
+}
+
+/// Return a mask of the output bytes that were balanced significantly more often than the 1 in 256 structures expected of a random permutation,
+/// i.e. more than 4 standard deviations above it. This includes the bytes that were always balanced.
+uint16_t integral_partially_balanced(const IntegralPattern* pattern) {
+    double expected = pattern->structures / 256.0;
+    double threshold = expected + 4 * sqrt(expected * 255 / 256);
+
+    uint16_t mask = 0;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        if (pattern->structures > 0 && pattern->balanced[pos] > threshold) {
+            mask |= 1 << pos;
+        }
+    }
+    return mask;
+}
+
+/// Score used to rank patterns: the summed rate at which the output bytes are balanced, relative to the 1/256 expected of a random permutation.
+/// A pattern where all 16 bytes are always balanced scores 16 * 255 / 256, a pattern without any property about 0.
+double integral_score(const IntegralPattern* pattern) {
+    if (pattern->structures == 0) {
+        return 0;
+    }
+
+    double score = 0;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        score += (double) pattern->balanced[pos] / pattern->structures - 1.0 / 256;
+    }
+    return score;
+}
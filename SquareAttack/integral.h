@@ -0,0 +1,30 @@
+#ifndef INC_02255_HW1_GROUP33_INTEGRAL_H
+#define INC_02255_HW1_GROUP33_INTEGRAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../AES/aes.h"
+#include "../Helpers/helpers.h"
+
+#define INTEGRAL_MAX_ACTIVE 3 // A structure with k active bytes has 256^k blocks, so more than 3 is not practical
+
+/// Statistics of one integral pattern: a set of active plaintext bytes, encrypted with a number of rounds.
+typedef struct {
+    uint16_t active; // Bit i is set if byte i of the plaintext takes all 256 values
+    size_t rounds;
+    uint64_t structures; // Number of structures evaluated
+    uint64_t balanced[BLOCK_SIZE]; // For each output byte, the number of structures in which it XORs to 0
+} IntegralPattern;
+
+size_t structure_blocks(uint16_t active);
+void fill_structure(unsigned char* blocks, uint16_t active, const unsigned char* base);
+uint16_t balanced_bytes(const unsigned char* blocks, size_t n);
+
+void integral_init(IntegralPattern* pattern, uint16_t active, size_t rounds);
+void integral_evaluate(IntegralPattern* pattern, EncryptBlocksFn encrypt, size_t structures, unsigned char* buf, uint64_t* seed);
+uint16_t integral_always_balanced(const IntegralPattern* pattern);
+uint16_t integral_partially_balanced(const IntegralPattern* pattern);
+double integral_score(const IntegralPattern* pattern);
+
+#endif //INC_02255_HW1_GROUP33_INTEGRAL_H
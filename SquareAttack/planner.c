@@ -0,0 +1,40 @@
+#include <math.h>
+#include <stdint.h>
+
+#include "planner.h"
+
+/// Number of lambda sets needed to eliminate all of the given wrong guesses with at least the target probability,
+/// if each of them independently survives a set with the given probability: the smallest n with (1 - survival^n)^wrong_guesses >= target.
+size_t plan_lambda_sets(size_t wrong_guesses, double survival, double target) {
+    if (wrong_guesses == 0) {
+        return 0;
+    }
+    if (survival <= 0) {
+        return 1;
+    }
+    if (target >= 1 || survival >= 1) {
+        return SIZE_MAX;
+    }
+
+    // survival^n <= 1 - target^(1 / wrong_guesses), computed with expm1 because the right-hand side is tiny
+    double per_guess = -expm1(log(target) / wrong_guesses);
+    double n = ceil(log(per_guess) / log(survival));
+    return n < 1 ? 1 : (size_t) n;
+}
+
+/// Estimate the probability that a wrong guess survives a lambda set from how fast the candidates have decayed so far.
+/// Falls back to the model of WRONG_GUESS_SURVIVAL before the first set, and once no wrong guesses are left.
+double measured_survival(const AttackContext* ctx) {
+    size_t wrong = attack_wrong_candidates(ctx);
+    if (ctx->sets_used == 0 || wrong == 0) {
+        return WRONG_GUESS_SURVIVAL;
+    }
+    return pow((double) wrong / (BLOCK_SIZE * 255), 1.0 / ctx->sets_used);
+}
+
+/// Number of additional lambda sets to request in one batch, so that the attack completes with at least the target probability.
+/// Before any set has been analysed, all 255 wrong guesses of each position are left, and the 2^-8 model is used.
+/// Afterwards, the wrong guesses that are actually left and the measured decay are used instead.
+size_t plan_attack(const AttackContext* ctx, double target) {
+    return plan_lambda_sets(attack_wrong_candidates(ctx), measured_survival(ctx), target);
+}
@@ -0,0 +1,14 @@
+#ifndef INC_02255_HW1_GROUP33_PLANNER_H
+#define INC_02255_HW1_GROUP33_PLANNER_H
+
+#include <stddef.h>
+
+#include "attack.h"
+
+#define WRONG_GUESS_SURVIVAL (1.0 / 256) // Probability that a wrong key byte passes the balance test of a single lambda set
+
+size_t plan_lambda_sets(size_t wrong_guesses, double survival, double target);
+double measured_survival(const AttackContext* ctx);
+size_t plan_attack(const AttackContext* ctx, double target);
+
+#endif //INC_02255_HW1_GROUP33_PLANNER_H
@@ -0,0 +1,235 @@
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shard.h"
+#include "../AES/aes.h"
+
+#define PROGRESS_INTERVAL 4096 // Guesses tested between two updates of a worker's progress counter
+
+/// Map a job into shared memory, and fill it with the candidates of an attack and the known pairs used to verify them.
+/// Returns NULL if the guess space is too large, or if the mapping fails.
+ShardJob* shard_job_create(const AttackContext* ctx, const unsigned char* plaintexts, const unsigned char* ciphertexts, size_t pairs) {
+    if (pairs == 0 || pairs > SHARD_MAX_PAIRS) {
+        return NULL;
+    }
+
+    uint64_t space;
+    if (!attack_guess_space(ctx, SHARD_MAX_SPACE_BITS, &space)) {
+        return NULL;
+    }
+
+    ShardJob* job = mmap(NULL, sizeof(ShardJob), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (job == MAP_FAILED) {
+        return NULL;
+    }
+
+    // Anonymous mappings are zero-filled, so progress counters, results and shard flags start out cleared
+    job->rounds = ctx->rounds;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        job->counts[pos] = attack_candidates(ctx, pos, job->candidates[pos]);
+    }
+    job->space = space;
+    job->shard_size = (space + SHARD_COUNT - 1) / SHARD_COUNT;
+
+    job->pairs = pairs;
+    memcpy(job->plaintexts, plaintexts, pairs * BLOCK_SIZE);
+    memcpy(job->ciphertexts, ciphertexts, pairs * BLOCK_SIZE);
+
+    return job;
+}
+
+/// Check whether a last round key candidate encrypts all known plaintexts to their ciphertexts.
+/// On success, the candidate is turned into the original cipher key in place.
+static bool verify_candidate(const ShardJob* job, unsigned char* key) {
+    for (size_t round = job->rounds; round > 0; round--) {
+        derive_previous_key(key, round - 1);
+    }
+
+    unsigned char round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+    expand_key(key, round_keys, job->rounds);
+
+    for (size_t i = 0; i < job->pairs; i++) {
+        unsigned char block[BLOCK_SIZE];
+        encrypt_block(block, job->plaintexts[i], round_keys, job->rounds);
+        if (memcmp(block, job->ciphertexts[i], BLOCK_SIZE) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Test all guesses in one shard. The index of a guess is read as a mixed-radix number with one digit per byte position,
+/// which is decoded once at the start of the shard and then counted up like an odometer.
+static void run_shard(ShardJob* job, ShardWorker* worker, uint64_t start, uint64_t end) {
+    size_t digits[BLOCK_SIZE];
+    uint64_t rest = start;
+    for (size_t pos = BLOCK_SIZE; pos > 0; pos--) {
+        digits[pos - 1] = rest % job->counts[pos - 1];
+        rest /= job->counts[pos - 1];
+    }
+
+    for (uint64_t i = start; i < end; i++) {
+        unsigned char key[BLOCK_SIZE];
+        for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+            key[pos] = job->candidates[pos][digits[pos]];
+        }
+
+        size_t found = atomic_load_explicit(&worker->found, memory_order_relaxed);
+        if (verify_candidate(job, key) && found < SHARD_MAX_RESULTS) {
+            memcpy(worker->results[found], key, BLOCK_SIZE);
+            atomic_store_explicit(&worker->found, found + 1, memory_order_release);
+        }
+
+        for (size_t pos = BLOCK_SIZE; pos > 0; pos--) {
+            if (++digits[pos - 1] < job->counts[pos - 1]) {
+                break;
+            }
+            digits[pos - 1] = 0;
+        }
+
+        if ((i - start + 1) % PROGRESS_INTERVAL == 0) {
+            atomic_fetch_add_explicit(&worker->progress, PROGRESS_INTERVAL, memory_order_relaxed);
+        }
+    }
+    atomic_fetch_add_explicit(&worker->progress, (end - start) % PROGRESS_INTERVAL, memory_order_relaxed);
+}
+
+/// Body of a forked worker, which processes every shard whose index is congruent to its own index modulo the number of workers.
+/// Shards that are already marked as done (e.g. when a job is resumed) are skipped.
+static void run_worker(ShardJob* job, size_t index, size_t workers) {
+    ShardWorker* worker = &job->workers[index];
+    for (size_t shard = index; shard < SHARD_COUNT; shard += workers) {
+        uint64_t start = shard * job->shard_size;
+        uint64_t end = start + job->shard_size;
+        if (start >= job->space) {
+            break;
+        }
+        if (end > job->space) {
+            end = job->space;
+        }
+
+        if (atomic_load_explicit(&job->shard_done[shard], memory_order_relaxed)) {
+            atomic_fetch_add_explicit(&worker->progress, end - start, memory_order_relaxed);
+            continue;
+        }
+
+        run_shard(job, worker, start, end);
+        atomic_store_explicit(&job->shard_done[shard], 1, memory_order_release);
+    }
+}
+
+/// Sum up the progress counters of all workers.
+static uint64_t total_progress(ShardJob* job, size_t workers) {
+    uint64_t done = 0;
+    for (size_t i = 0; i < workers; i++) {
+        done += atomic_load_explicit(&job->workers[i].progress, memory_order_relaxed);
+    }
+    return done;
+}
+
+/// Fork the given number of workers, and wait until all of them have finished while reporting their combined progress.
+/// Returns 0 on success, and -1 if a worker could not be started or did not exit cleanly.
+int shard_job_run(ShardJob* job, size_t workers, ShardProgressFn progress, void* user) {
+    if (workers == 0 || workers > SHARD_MAX_WORKERS) {
+        return -1;
+    }
+
+    pid_t pids[SHARD_MAX_WORKERS];
+    size_t started = 0;
+    int result = 0;
+    for (size_t i = 0; i < workers; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_worker(job, i, workers);
+            _exit(0);
+        } else if (pid < 0) {
+            result = -1; // Wait for the workers that did start, but report the failure
+            break;
+        }
+        pids[started++] = pid;
+    }
+
+    // Only wait for our own workers, so that other children of a host process are left alone
+    const struct timespec poll_interval = {0, 100 * 1000 * 1000};
+    size_t running = started, polls = 0;
+    while (running > 0) {
+        for (size_t i = 0; i < started; i++) {
+            int status;
+            if (pids[i] > 0 && waitpid(pids[i], &status, WNOHANG) == pids[i]) {
+                pids[i] = 0;
+                running--;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    result = -1;
+                }
+            }
+        }
+
+        if (running > 0) {
+            nanosleep(&poll_interval, NULL);
+            if (progress != NULL && ++polls % 10 == 0) {
+                progress(total_progress(job, workers), job->space, user);
+            }
+        }
+    }
+
+    if (progress != NULL) {
+        progress(total_progress(job, workers), job->space, user);
+    }
+    return result;
+}
+
+/// Add a key to the first n entries of keys unless it is already there, and return the new number of entries.
+/// Keys past max are only counted. A key can be found twice if a job was resumed in the middle of the shard containing it.
+static size_t add_unique_key(unsigned char* keys, size_t n, size_t max, const unsigned char* key) {
+    for (size_t i = 0; i < n && i < max; i++) {
+        if (memcmp(&keys[i * BLOCK_SIZE], key, BLOCK_SIZE) == 0) {
+            return n;
+        }
+    }
+    if (n < max) {
+        memcpy(&keys[n * BLOCK_SIZE], key, BLOCK_SIZE);
+    }
+    return n + 1;
+}
+
+/// Copy the keys found by all workers, and before a resume, into keys, which has room for max keys. Returns the total number found.
+/// This can be called while the workers are still running.
+size_t shard_job_results(ShardJob* job, unsigned char* keys, size_t max) {
+    size_t n = 0;
+    for (size_t i = 0; i < job->restored; i++) {
+        n = add_unique_key(keys, n, max, job->restored_results[i]);
+    }
+    for (size_t i = 0; i < SHARD_MAX_WORKERS; i++) {
+        size_t found = atomic_load_explicit(&job->workers[i].found, memory_order_acquire);
+        for (size_t j = 0; j < found; j++) {
+            n = add_unique_key(keys, n, max, job->workers[i].results[j]);
+        }
+    }
+    return n;
+}
+
+/// Copy which shards are done (SHARD_COUNT flags) and the keys found so far, while the workers keep running.
+/// The flags are read before the keys, and a worker only marks a shard as done after writing its keys, so no key of a done shard can be missed.
+size_t shard_job_snapshot(ShardJob* job, unsigned char* shard_done, unsigned char* keys, size_t max) {
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        shard_done[i] = atomic_load_explicit(&job->shard_done[i], memory_order_acquire);
+    }
+    return shard_job_results(job, keys, max);
+}
+
+/// Restore the state saved by shard_job_snapshot into a freshly created job for the same candidates, before running it.
+void shard_job_restore(ShardJob* job, const unsigned char* shard_done, const unsigned char* keys, size_t n) {
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        atomic_store_explicit(&job->shard_done[i], shard_done[i], memory_order_relaxed);
+    }
+    job->restored = n < SHARD_MAX_RESULTS ? n : SHARD_MAX_RESULTS;
+    memcpy(job->restored_results, keys, job->restored * BLOCK_SIZE);
+}
+
+/// Unmap a job.
+void shard_job_destroy(ShardJob* job) {
+    munmap(job, sizeof(ShardJob));
+}
@@ -0,0 +1,53 @@
+#ifndef INC_02255_HW1_GROUP33_SHARD_H
+#define INC_02255_HW1_GROUP33_SHARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "attack.h"
+
+#define SHARD_MAX_WORKERS 256
+#define SHARD_MAX_PAIRS 4 // Known plaintext/ciphertext pairs used to verify a key candidate
+#define SHARD_MAX_RESULTS 16 // Surviving candidates each worker can report
+#define SHARD_MAX_SPACE_BITS 40 // Largest guess space the coordinator accepts
+#define SHARD_COUNT 4096 // The guess space is cut into this many shards, which are dealt out to the workers round-robin
+
+/// Called by the coordinator about once per second, and once more after all workers have finished.
+typedef void (*ShardProgressFn)(uint64_t done, uint64_t total, void* user);
+
+/// Mutable state of a single worker. Each one lives on its own cache lines, and is only ever written by its owner,
+/// so workers never contend for memory no matter on which socket they run.
+typedef struct {
+    _Alignas(64) _Atomic uint64_t progress; // Number of guesses tested so far
+    _Atomic size_t found; // Number of entries used in results, only increased after the result has been written
+    unsigned char results[SHARD_MAX_RESULTS][BLOCK_SIZE]; // Recovered cipher keys that matched all known pairs
+} ShardWorker;
+
+/// Everything the workers need, placed in a single shared anonymous mapping.
+/// The inputs are written once by the coordinator before forking, and are read-only afterwards.
+typedef struct {
+    size_t rounds;
+    size_t counts[BLOCK_SIZE]; // Number of candidates for each byte of the last round key
+    unsigned char candidates[BLOCK_SIZE][256];
+    uint64_t space; // Product of all counts
+    uint64_t shard_size;
+
+    size_t pairs;
+    unsigned char plaintexts[SHARD_MAX_PAIRS][BLOCK_SIZE];
+    unsigned char ciphertexts[SHARD_MAX_PAIRS][BLOCK_SIZE];
+
+    _Atomic unsigned char shard_done[SHARD_COUNT]; // Set by the owning worker when it has tested every guess in a shard
+    size_t restored; // Number of entries used in restored_results
+    unsigned char restored_results[SHARD_MAX_RESULTS][BLOCK_SIZE]; // Keys found before the job was resumed
+    ShardWorker workers[SHARD_MAX_WORKERS];
+} ShardJob;
+
+ShardJob* shard_job_create(const AttackContext* ctx, const unsigned char* plaintexts, const unsigned char* ciphertexts, size_t pairs);
+int shard_job_run(ShardJob* job, size_t workers, ShardProgressFn progress, void* user);
+size_t shard_job_results(ShardJob* job, unsigned char* keys, size_t max);
+size_t shard_job_snapshot(ShardJob* job, unsigned char* shard_done, unsigned char* keys, size_t max);
+void shard_job_restore(ShardJob* job, const unsigned char* shard_done, const unsigned char* keys, size_t n);
+void shard_job_destroy(ShardJob* job);
+
+#endif //INC_02255_HW1_GROUP33_SHARD_H
@@ -1,23 +1,21 @@
-#include <malloc.h>
 #include <limits.h>
 #include <string.h>
 
 #include "square.h"
 #include "../AES/aes.h"
 #include "../AES/constants.h"
+#include "../Helpers/alloc_track.h"
 #include "../Helpers/helpers.h"
 
-const size_t SETS = 256;
-
 #pragma region Lambdas
 
 /// Generate a lambda set with a unique value for the first byte and random values for the remaining positions (but the same random value in each block).
 unsigned char** generate_lambda_set(unsigned int seed) {
-    unsigned char** lambda = malloc(sizeof(unsigned char*) * SETS);
+    unsigned char** lambda = tracked_malloc(sizeof(unsigned char*) * SETS);
 
     unsigned char* arr = generate_block(seed); // Using the same randomized values across all 256 blocks
     for (size_t i = 0; i < SETS; i++) {
-        lambda[i] = malloc(sizeof(unsigned char) * BLOCK_SIZE);
+        lambda[i] = tracked_malloc(sizeof(unsigned char) * BLOCK_SIZE);
 
         // Assigning index of set to first element of each block so that each set's first value is unique
         lambda[i][0] = i;
@@ -27,13 +25,14 @@ unsigned char** generate_lambda_set(unsigned int seed) {
             lambda[i][j] = arr[j];
         }
     }
+    tracked_free(arr);
 
     return lambda;
 }
 
 /// Generate multiple lambda sets at once.
 unsigned char*** generate_lambda_sets(size_t n) {
-    unsigned char*** lambdas = malloc(sizeof(unsigned char*) * n);
+    unsigned char*** lambdas = tracked_malloc(sizeof(unsigned char*) * n);
 
     for (size_t i = 0; i < n; i++) {
         lambdas[i] = generate_lambda_set(i);
@@ -42,6 +41,17 @@ unsigned char*** generate_lambda_sets(size_t n) {
     return lambdas;
 }
 
+/// Generate a lambda set into a caller-provided buffer of SETS * BLOCK_SIZE bytes, with the blocks stored one after another.
+/// The contents are the same as the ones of generate_lambda_set with the same seed.
+void fill_lambda_set(unsigned char* lambda, unsigned int seed) {
+    unsigned char arr[BLOCK_SIZE];
+    fill_block(arr, seed);
+    for (size_t i = 0; i < SETS; i++) {
+        memcpy(&lambda[i * BLOCK_SIZE], arr, BLOCK_SIZE);
+        lambda[i * BLOCK_SIZE] = i;
+    }
+}
+
 #pragma endregion
 
 #pragma region Reversal
@@ -49,25 +59,19 @@ unsigned char*** generate_lambda_sets(size_t n) {
 /// Reverse the last round of a block given a single byte of the key, and its corresponding position in the block.
 /// Return the reversed byte at the given position.
 unsigned char reverse_last_round(const unsigned char* block, unsigned char key, size_t key_pos) {
-    unsigned char* copy = malloc(sizeof(unsigned char) * BLOCK_SIZE);
-    memcpy(copy, block, BLOCK_SIZE);
-
-    copy[key_pos] ^= key; // Reverse AddRoundKey
-    sub_bytes(&copy[key_pos], InverseSBox, 1); // Inverse SubBytes on single byte
-
-    unsigned char value = copy[key_pos];
-    free(copy);
+    unsigned char value = block[key_pos] ^ key; // Reverse AddRoundKey
+    sub_bytes(&value, InverseSBox, 1); // Inverse SubBytes on single byte
 
     return value;
 }
 
 /// Make a guess for a byte of the last round key in the given position, and return the array of best guesses.
 unsigned char* guess_round_key(unsigned char** lambda, size_t key_pos, size_t* no_of_guesses) {
-    unsigned char* guesses = malloc(sizeof(unsigned char) * SETS);
-    unsigned char guesses_count = 0;
+    unsigned char* guesses = tracked_malloc(sizeof(unsigned char) * SETS);
+    size_t guesses_count = 0;
 
-    for (unsigned char guess = 0; guess < (unsigned char) UCHAR_MAX; guess++) { // go through all possible guesses
-        unsigned char* values = malloc(sizeof(unsigned char) * SETS); // store all 256 reversed values with guess
+    for (unsigned int guess = 0; guess <= UCHAR_MAX; guess++) { // go through all possible guesses
+        unsigned char* values = tracked_malloc(sizeof(unsigned char) * SETS); // store all 256 reversed values with guess
         for (size_t i = 0; i < SETS; i++) {
             values[i] = reverse_last_round(lambda[i], guess, key_pos);
         }
@@ -83,7 +87,7 @@ unsigned char* guess_round_key(unsigned char** lambda, size_t key_pos, size_t* n
             guesses_count++;
         }
 
-        free(values);
+        tracked_free(values);
     }
 
     *no_of_guesses = guesses_count; // Assign no. of guesses to pointer passed in so that the caller knows the size
@@ -91,4 +95,135 @@ unsigned char* guess_round_key(unsigned char** lambda, size_t key_pos, size_t* n
     return guesses;
 }
 
-#pragma endregion
\ No newline at end of file
+/// Make a guess for a byte of the last round key in the given position, for a lambda set stored as SETS consecutive blocks.
+/// All 256 guesses are tested, and the ones for which the reversed values XOR to 0 are marked in the mask.
+void guess_round_key_mask(const unsigned char* lambda, size_t key_pos, CandidateMask* mask) {
+    mask_clear(mask);
+    for (unsigned int guess = 0; guess <= UCHAR_MAX; guess++) {
+        unsigned char result = 0;
+        for (size_t i = 0; i < SETS; i++) {
+            result ^= InverseSBox[lambda[i * BLOCK_SIZE + key_pos] ^ guess];
+        }
+
+        if (result == 0) {
+            mask_set(mask, guess);
+        }
+    }
+}
+
+/// Single pass over a lambda set that records, for every position, which byte values occur an odd number of times.
+/// Each block is read once, and all 16 positions are updated from it, instead of one pass per position.
+/// Values that occur an even number of times cancel out in the XOR of the balance test, so this is all the key guessing needs.
+void lambda_set_parity(const unsigned char* lambda, CandidateMask* parity) {
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        mask_clear(&parity[pos]);
+    }
+
+    for (size_t i = 0; i < SETS; i++) {
+        for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+            unsigned char value = lambda[i * BLOCK_SIZE + pos];
+            parity[pos].bits[value >> 6] ^= (uint64_t) 1 << (value & 63);
+        }
+    }
+}
+
+/// Choose the smaller of the set of odd values and its complement, which give the same XOR sum: the inverse S-Box of v ^ guess,
+/// XORed over all 256 values of v, is the XOR of all bytes, which is 0. This way at most 128 values have to be reversed per guess.
+void parity_odd_values(const CandidateMask* parity, CandidateMask* values) {
+    *values = *parity;
+    if (mask_count(values) > SETS / 2) {
+        mask_not(values);
+    }
+}
+
+/// Turn the parity of all 16 positions into candidate masks, by testing every guess against the odd values only.
+void guess_round_keys_from_parity(const CandidateMask* parity, CandidateMask* masks) {
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        CandidateMask odd;
+        parity_odd_values(&parity[pos], &odd);
+        unsigned char values[SETS];
+        size_t n = mask_to_array(&odd, values);
+
+        unsigned char sums[SETS] = {0};
+        for (size_t i = 0; i < n; i++) {
+            for (unsigned int guess = 0; guess <= UCHAR_MAX; guess++) {
+                sums[guess] ^= InverseSBox[values[i] ^ guess];
+            }
+        }
+
+        mask_clear(&masks[pos]);
+        for (unsigned int guess = 0; guess <= UCHAR_MAX; guess++) {
+            if (sums[guess] == 0) {
+                mask_set(&masks[pos], guess);
+            }
+        }
+    }
+}
+
+/// Make a guess for all 16 bytes of the last round key at once, reading the lambda set only a single time.
+/// Gives the same masks as calling guess_round_key_mask for every position.
+void guess_all_round_key_masks(const unsigned char* lambda, CandidateMask* masks) {
+    CandidateMask parity[BLOCK_SIZE];
+    lambda_set_parity(lambda, parity);
+    guess_round_keys_from_parity(parity, masks);
+}
+
+#pragma endregion
+
+#pragma region Candidate masks
+
+/// Mark all 256 values as candidates.
+void mask_fill(CandidateMask* mask) {
+    memset(mask->bits, 0xff, sizeof(mask->bits));
+}
+
+/// Remove all candidates.
+void mask_clear(CandidateMask* mask) {
+    memset(mask->bits, 0, sizeof(mask->bits));
+}
+
+/// Mark a single value as a candidate.
+void mask_set(CandidateMask* mask, unsigned char value) {
+    mask->bits[value >> 6] |= (uint64_t) 1 << (value & 63);
+}
+
+/// Check whether a value is a candidate.
+bool mask_test(const CandidateMask* mask, unsigned char value) {
+    return (mask->bits[value >> 6] >> (value & 63)) & 1;
+}
+
+/// Intersect two masks, and store the result in the first argument.
+void mask_and(CandidateMask* a, const CandidateMask* b) {
+    for (size_t i = 0; i < 4; i++) {
+        a->bits[i] &= b->bits[i];
+    }
+}
+
+/// Turn every candidate into a non-candidate, and vice versa.
+void mask_not(CandidateMask* mask) {
+    for (size_t i = 0; i < 4; i++) {
+        mask->bits[i] = ~mask->bits[i];
+    }
+}
+
+/// Count the number of candidates in the mask.
+size_t mask_count(const CandidateMask* mask) {
+    size_t count = 0;
+    for (size_t i = 0; i < 4; i++) {
+        count += __builtin_popcountll(mask->bits[i]);
+    }
+    return count;
+}
+
+/// Write the candidates in ascending order into values, which has to hold up to 256 entries. Returns the number written.
+size_t mask_to_array(const CandidateMask* mask, unsigned char* values) {
+    size_t n = 0;
+    for (unsigned int v = 0; v <= UCHAR_MAX; v++) {
+        if (mask_test(mask, v)) {
+            values[n++] = v;
+        }
+    }
+    return n;
+}
+
+#pragma endregion
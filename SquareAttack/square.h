@@ -1,9 +1,18 @@
 #ifndef INC_02255_HW1_GROUP33_SQUARE_H
 #define INC_02255_HW1_GROUP33_SQUARE_H
 
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 //#define DEBUG_SQUARE // comment this out to disable debug mode
 
-extern const size_t SETS;
+#define SETS 256 // Number of blocks in a lambda set
+
+/// Set of candidates for a single key byte, with one bit for each of the 256 possible values.
+typedef struct {
+    uint64_t bits[4];
+} CandidateMask;
 
 unsigned char** generate_lambda_set(unsigned int seed);
 unsigned char*** generate_lambda_sets(size_t n);
@@ -11,4 +20,20 @@ unsigned char*** generate_lambda_sets(size_t n);
 unsigned char reverse_last_round(const unsigned char* block, unsigned char key, size_t key_pos);
 unsigned char* guess_round_key(unsigned char** lambda, size_t key_pos, size_t* no_of_guesses);
 
+void fill_lambda_set(unsigned char* lambda, unsigned int seed);
+void guess_round_key_mask(const unsigned char* lambda, size_t key_pos, CandidateMask* mask);
+void lambda_set_parity(const unsigned char* lambda, CandidateMask* parity);
+void parity_odd_values(const CandidateMask* parity, CandidateMask* values);
+void guess_round_keys_from_parity(const CandidateMask* parity, CandidateMask* masks);
+void guess_all_round_key_masks(const unsigned char* lambda, CandidateMask* masks);
+
+void mask_fill(CandidateMask* mask);
+void mask_clear(CandidateMask* mask);
+void mask_set(CandidateMask* mask, unsigned char value);
+bool mask_test(const CandidateMask* mask, unsigned char value);
+void mask_and(CandidateMask* a, const CandidateMask* b);
+void mask_not(CandidateMask* mask);
+size_t mask_count(const CandidateMask* mask);
+size_t mask_to_array(const CandidateMask* mask, unsigned char* values);
+
 #endif //INC_02255_HW1_GROUP33_SQUARE_H
@@ -0,0 +1,24 @@
+# Resuming a checkpoint must only work for the key and number of rounds it was written for.
+# Run with cmake -DATTACK=<path to 02255_HW1_Group33> -DCHECKPOINT=<scratch file> -P checkpoint_resume.cmake
+file(REMOVE ${CHECKPOINT})
+
+execute_process(COMMAND ${ATTACK} --checkpoint ${CHECKPOINT} RESULT_VARIABLE result OUTPUT_QUIET)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "The attack with the default key failed")
+endif ()
+
+execute_process(COMMAND ${ATTACK} --checkpoint ${CHECKPOINT} --resume 00112233445566778899aabbccddeeff
+                RESULT_VARIABLE result OUTPUT_VARIABLE output)
+if (result EQUAL 0)
+    message(FATAL_ERROR "Resumed a checkpoint of another key:\n${output}")
+endif ()
+if (NOT output MATCHES "belongs to another cipher key")
+    message(FATAL_ERROR "Unexpected output when resuming a checkpoint of another key:\n${output}")
+endif ()
+
+execute_process(COMMAND ${ATTACK} --checkpoint ${CHECKPOINT} --resume RESULT_VARIABLE result OUTPUT_VARIABLE output)
+if (NOT result EQUAL 0 OR NOT output MATCHES "Recovered original cipher key:[ \n]*2b 28 ab 09")
+    message(FATAL_ERROR "Could not resume the checkpoint of the default key:\n${output}")
+endif ()
+
+file(REMOVE ${CHECKPOINT})
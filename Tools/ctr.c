@@ -0,0 +1,178 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "AES/aes.h"
+#include "AES/ctr.h"
+#include "Engines/engine.h"
+#include "Helpers/alloc_track.h"
+#include "Helpers/helpers.h"
+
+#define MAX_THREADS 256
+
+/// The part of the file a single thread encrypts.
+typedef struct {
+    pthread_t thread;
+    bool started; // Whether the chunk runs on its own thread, and has to be joined
+    const EncryptEngine* engine;
+    const unsigned char* round_keys;
+    size_t rounds;
+    const unsigned char* iv;
+
+    const unsigned char* in;
+    unsigned char* out;
+    size_t len;
+    uint64_t first_block;
+} Chunk;
+
+void* encrypt_chunk(void* arg) {
+    Chunk* chunk = arg;
+    ctr_crypt(chunk->engine->encrypt_blocks, chunk->out, chunk->in, chunk->len, chunk->round_keys, chunk->rounds, chunk->iv, chunk->first_block);
+    return NULL;
+}
+
+void print_usage(const char* name) {
+    printf("Usage: %s [--rounds R] [--threads N] [--engine NAME] [--iv HEX] KEY INPUT OUTPUT\n\n"
+           "Encrypts (or decrypts) INPUT into OUTPUT with AES in counter mode, with any number of rounds from 1 to %d.\n"
+           "KEY and the initial counter block IV are 32-char hex strings in the standard AES byte order, as for openssl enc -K and -iv.\n"
+           "INPUT and OUTPUT may be the same file, which is then encrypted in place.\n", name, MAX_ROUNDS);
+}
+
+int main(int argc, char* argv[]) {
+    size_t rounds = MAX_ROUNDS;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads; // Only an explicit --threads out of range is an error
+    const char* engine_name = NULL;
+    unsigned char iv[BLOCK_SIZE] = {0};
+    const char* positional[3];
+    size_t n_positional = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engine_name = argv[++i];
+        } else if (strcmp(argv[i], "--iv") == 0 && i + 1 < argc) {
+            if (!parse_block(argv[++i], iv)) {
+                printf("The IV has to be a 32-char hex string.\n");
+                return 1;
+            }
+        } else if (n_positional < 3) {
+            positional[n_positional++] = argv[i];
+        } else {
+            n_positional++; // Too many arguments
+        }
+    }
+
+    if (n_positional != 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (rounds < 1 || rounds > MAX_ROUNDS || threads < 1 || threads > MAX_THREADS) {
+        printf("The number of rounds has to be between 1 and %d, and the number of threads between 1 and %d.\n", MAX_ROUNDS, MAX_THREADS);
+        return 1;
+    }
+
+    unsigned char key_bytes[BLOCK_SIZE], key[BLOCK_SIZE];
+    if (!parse_block(positional[0], key_bytes)) {
+        printf("The key has to be a 32-char hex string.\n");
+        return 1;
+    }
+    transpose_block(key, key_bytes); // The key schedule works on the key row by row
+
+    const EncryptEngine* engine = select_encrypt_engine(engine_name);
+    if (engine == NULL) {
+        printf("The selected engine does not exist or is not supported by this CPU.\n");
+        return 1;
+    }
+
+    int in_fd = open(positional[1], O_RDONLY);
+    struct stat st, out_st;
+    if (in_fd < 0 || fstat(in_fd, &st) != 0) {
+        perror(positional[1]);
+        return 1;
+    }
+    size_t len = st.st_size;
+
+    // If the output is the input file, encrypt it in place through a single shared mapping. Opening it with O_TRUNC would lose the input.
+    bool in_place = stat(positional[2], &out_st) == 0 && out_st.st_dev == st.st_dev && out_st.st_ino == st.st_ino;
+    int out_fd = open(positional[2], in_place ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0 || (!in_place && ftruncate(out_fd, len) != 0)) {
+        perror(positional[2]);
+        return 1;
+    }
+
+    if (len == 0) { // Empty files cannot be mapped, and there is nothing to encrypt anyway
+        close(in_fd);
+        close(out_fd);
+        return 0;
+    }
+
+    unsigned char* out = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, out_fd, 0);
+    unsigned char* in = in_place ? out : mmap(NULL, len, PROT_READ, MAP_PRIVATE, in_fd, 0);
+    if (in == MAP_FAILED || out == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    madvise(in, len, MADV_SEQUENTIAL);
+    madvise(out, len, MADV_SEQUENTIAL);
+
+    unsigned char round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+    expand_key(key, round_keys, rounds);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Give every thread an equal number of whole blocks, so that each one can compute its own counters
+    size_t blocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    size_t blocks_per_thread = (blocks + threads - 1) / threads;
+    Chunk chunks[MAX_THREADS] = {0};
+    for (size_t t = 0; t < (size_t) threads; t++) {
+        size_t offset = t * blocks_per_thread * BLOCK_SIZE;
+        if (offset >= len) {
+            break;
+        }
+        size_t chunk_len = blocks_per_thread * BLOCK_SIZE < len - offset ? blocks_per_thread * BLOCK_SIZE : len - offset;
+
+        Chunk* chunk = &chunks[t];
+        chunk->engine = engine;
+        chunk->round_keys = round_keys;
+        chunk->rounds = rounds;
+        chunk->iv = iv;
+        chunk->in = &in[offset];
+        chunk->out = &out[offset];
+        chunk->len = chunk_len;
+        chunk->first_block = t * blocks_per_thread;
+
+        chunk->started = pthread_create(&chunk->thread, NULL, encrypt_chunk, chunk) == 0;
+        if (!chunk->started) {
+            encrypt_chunk(chunk); // Fall back to doing the work on this thread
+        }
+    }
+    for (size_t t = 0; t < (size_t) threads; t++) {
+        if (chunks[t].started) {
+            pthread_join(chunks[t].thread, NULL);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "Encrypted %zu bytes with %zu rounds in %.3f s (%.2f GB/s) using the %s engine and %ld threads\n",
+            len, rounds, elapsed, len / elapsed / 1e9, engine->name, threads);
+
+    if (!in_place) {
+        munmap(in, len);
+    }
+    munmap(out, len);
+    close(in_fd);
+    close(out_fd);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Engines/engine.h"
+#include "Helpers/alloc_track.h"
+#include "Helpers/helpers.h"
+#include "SquareAttack/integral.h"
+
+#define MAX_THREADS 256
+
+/// Work shared by all search threads. Each thread takes the next pattern from the list until there are none left.
+typedef struct {
+    IntegralPattern* patterns;
+    size_t n_patterns;
+    _Atomic size_t next;
+    _Atomic size_t evaluated; // Patterns that were actually evaluated, less than n_patterns if every thread failed to allocate its buffer
+
+    const EncryptEngine* engine;
+    size_t structures;
+    size_t max_blocks; // Size of the largest structure, which every thread allocates once up front
+} Search;
+
+void* search_thread(void* arg) {
+    Search* search = arg;
+    unsigned char* buf = tracked_malloc(search->max_blocks * BLOCK_SIZE);
+    if (buf == NULL) {
+        return NULL; // The remaining patterns are evaluated by the other threads, if any of them could allocate a buffer
+    }
+
+    size_t i;
+    while ((i = atomic_fetch_add(&search->next, 1)) < search->n_patterns) {
+        uint64_t seed = 0x9e3779b97f4a7c15ULL * (i + 1); // Deterministic per pattern, independent of which thread evaluates it
+        integral_evaluate(&search->patterns[i], search->engine->encrypt_blocks, search->structures, buf, &seed);
+        atomic_fetch_add(&search->evaluated, 1);
+    }
+
+    tracked_free(buf);
+    return NULL;
+}
+
+/// Sort patterns by descending score, then by more rounds and fewer active bytes, since a property that holds for more rounds
+/// with a smaller structure is the more useful distinguisher.
+int compare_patterns(const void* a, const void* b) {
+    const IntegralPattern* pa = a;
+    const IntegralPattern* pb = b;
+    double sa = integral_score(pa), sb = integral_score(pb);
+    if (sa != sb) {
+        return sa < sb ? 1 : -1;
+    }
+    if (pa->rounds != pb->rounds) {
+        return pa->rounds < pb->rounds ? 1 : -1;
+    }
+    return __builtin_popcount(pa->active) - __builtin_popcount(pb->active);
+}
+
+/// Print a pattern as its number of rounds, its active bytes, and one character for each output byte:
+/// B if it was always balanced, b if it was balanced significantly more often than for a random permutation, and . otherwise.
+void print_pattern(const IntegralPattern* pattern) {
+    char active[BLOCK_SIZE * 3 + 1] = "", *p = active;
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        if (pattern->active & (1 << pos)) {
+            p += sprintf(p, p == active ? "%zu" : ",%zu", pos);
+        }
+    }
+
+    char map[BLOCK_SIZE + 1];
+    uint16_t always = integral_always_balanced(pattern);
+    uint16_t partially = integral_partially_balanced(pattern);
+    for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
+        map[pos] = always & (1 << pos) ? 'B' : partially & (1 << pos) ? 'b' : '.';
+    }
+    map[BLOCK_SIZE] = '\0';
+
+    printf("%6zu  %-12s  %s  %2d  %8.3f\n", pattern->rounds, active, map, __builtin_popcount(always), integral_score(pattern));
+}
+
+void print_usage(const char* name) {
+    printf("Usage: %s [--min-rounds R] [--max-rounds R] [--max-active K] [--structures N] [--threads N] [--engine NAME] [--top N]\n\n"
+           "Encrypts structures for every pattern of up to K active plaintext bytes (at most %d) and every number of rounds in the range,\n"
+           "and ranks the patterns by how often their output bytes are balanced.\n", name, INTEGRAL_MAX_ACTIVE);
+}
+
+int main(int argc, char* argv[]) {
+    size_t min_rounds = 2, max_rounds = 4, max_active = 1, structures = 64, top = 20;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads; // Only an explicit --threads out of range is an error
+    const char* engine_name = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--min-rounds") == 0) {
+            min_rounds = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-rounds") == 0) {
+            max_rounds = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-active") == 0) {
+            max_active = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--structures") == 0) {
+            structures = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--engine") == 0) {
+            engine_name = argv[++i];
+        } else if (strcmp(argv[i], "--top") == 0) {
+            top = strtoul(argv[++i], NULL, 10);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (min_rounds < 1 || max_rounds > MAX_ROUNDS || min_rounds > max_rounds || max_active < 1 || max_active > INTEGRAL_MAX_ACTIVE
+        || structures < 1 || threads < 1 || threads > MAX_THREADS) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    Search search = {0};
+    search.engine = select_encrypt_engine(engine_name);
+    if (search.engine == NULL) {
+        printf("The selected engine does not exist or is not supported by this CPU.\n");
+        return 1;
+    }
+    search.structures = structures;
+    search.max_blocks = (size_t) 1 << (8 * max_active);
+
+    // Every set of up to max_active active bytes, for every number of rounds
+    size_t capacity = (max_rounds - min_rounds + 1) * (1 << BLOCK_SIZE);
+    search.patterns = tracked_malloc(capacity * sizeof(IntegralPattern));
+    if (search.patterns == NULL) {
+        printf("Could not allocate %zu patterns.\n", capacity);
+        return 1;
+    }
+    for (size_t rounds = min_rounds; rounds <= max_rounds; rounds++) {
+        for (uint32_t active = 1; active < (1 << BLOCK_SIZE); active++) {
+            if ((size_t) __builtin_popcount(active) <= max_active) {
+                integral_init(&search.patterns[search.n_patterns++], active, rounds);
+            }
+        }
+    }
+
+    printf("Evaluating %zu patterns with %zu structures each, using the %s engine and %ld threads\n\n",
+           search.n_patterns, structures, search.engine->name, threads);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t workers[MAX_THREADS];
+    bool started[MAX_THREADS];
+    for (long t = 0; t < threads; t++) {
+        started[t] = pthread_create(&workers[t], NULL, search_thread, &search) == 0;
+        if (!started[t]) {
+            search_thread(&search); // Fall back to doing the work on this thread
+        }
+    }
+    for (long t = 0; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(workers[t], NULL);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    size_t evaluated = atomic_load(&search.evaluated);
+    if (evaluated < search.n_patterns) {
+        printf("Only %zu of %zu patterns were evaluated, since no thread could allocate its buffer of %zu bytes.\n",
+               evaluated, search.n_patterns, search.max_blocks * BLOCK_SIZE);
+        tracked_free(search.patterns);
+        return 1;
+    }
+
+    qsort(search.patterns, search.n_patterns, sizeof(IntegralPattern), compare_patterns);
+
+    printf("rounds  active        balance           #B     score\n");
+    for (size_t i = 0; i < search.n_patterns && i < top; i++) {
+        print_pattern(&search.patterns[i]);
+    }
+
+    double total = (double) evaluated * structures;
+    printf("\nEvaluated %.0f structures in %.2f s (%.0f structures per minute)\n", total, elapsed, total / elapsed * 60);
+
+    tracked_free(search.patterns);
+    return 0;
+}
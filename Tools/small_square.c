@@ -0,0 +1,289 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "AES/aes.h"
+#include "Helpers/alloc_track.h"
+#include "Helpers/helpers.h"
+#include "SmallAES/small_aes.h"
+
+#define MAX_THREADS 256
+#define MAX_SETS 256 // Upper limit for --max-sets, which is also the size of the histogram
+#define EXHAUSTIVE_KEY_BITS 24 // Every key is attacked if there are at most 2^24 of them, otherwise a random sample
+#define KEYS_PER_TASK 256 // Number of keys a thread takes from the shared counter at once
+
+/// Exact counts collected over all attacked keys. Each thread fills its own copy, and they are summed at the end.
+typedef struct {
+    uint64_t sets_needed[MAX_SETS + 1]; // Number of keys recovered with exactly i lambda sets
+    uint64_t incomplete; // Keys with more than one candidate left for some word after --max-sets sets
+    uint64_t wrong; // Keys for which the single remaining candidate was not the correct key (should never happen)
+    uint64_t survivors[SAES_WORDS][SAES_WORDS]; // Wrong guesses that passed the first set with each active word, per key word
+    uint64_t samples[SAES_WORDS]; // Number of keys that were still being attacked when each active word was first used
+} Statistics;
+
+/// Work shared by all threads. Keys are numbered, and each thread takes the next run of key indices until there are none left.
+typedef struct {
+    size_t rounds;
+    size_t max_sets;
+    uint64_t keys;
+    bool exhaustive; // Key index i is the key itself, instead of the seed of a random key
+    uint64_t seed;
+    _Atomic uint64_t next;
+    Statistics stats[MAX_THREADS];
+} Experiment;
+
+/// Write key number index into key: the words of the index itself when every key is attacked, random words otherwise.
+void key_from_index(const Experiment* experiment, uint64_t index, unsigned char* key) {
+    if (experiment->exhaustive) {
+        for (size_t i = 0; i < SAES_WORDS; i++) {
+            key[i] = (unsigned char) (index >> (i * SAES_WORD_BITS)) & (SAES_VALUES - 1);
+        }
+        return;
+    }
+
+    uint64_t state = experiment->seed ^ (0x9e3779b97f4a7c15ULL * (index + 1));
+    for (size_t i = 0; i < SAES_WORDS; i++) {
+        key[i] = (unsigned char) (next_random(&state) >> 56) & (SAES_VALUES - 1);
+    }
+}
+
+/// Attack a single key with lambda sets until every word of the last round key is known, and record the outcome.
+/// The active word moves through every position from one set to the next, since with an active word in a single position
+/// some words of the state can stay constant one round before the end (e.g. with 2 x 4 words), which tells nothing about their key.
+void attack_key(const Experiment* experiment, const unsigned char* key, uint64_t index, Statistics* stats) {
+    unsigned char round_keys[(SAES_MAX_ROUNDS + 1) * SAES_WORDS];
+    unsigned char lambda[SAES_VALUES * SAES_WORDS];
+    saes_expand_key(key, round_keys, experiment->rounds);
+
+    SmallAttack attack;
+    saes_attack_init(&attack, experiment->rounds);
+    uint64_t state = experiment->seed ^ (0xbf58476d1ce4e5b9ULL * (index + 1)) ^ 1;
+
+    SmallMask masks[SAES_WORDS];
+    while (attack.sets_used < experiment->max_sets && !saes_attack_is_complete(&attack)) {
+        size_t active = attack.sets_used % SAES_WORDS;
+        saes_fill_lambda_set(lambda, active, &state);
+        saes_encrypt_blocks(lambda, lambda, SAES_VALUES, round_keys, experiment->rounds);
+        saes_guess_round_keys(lambda, masks);
+
+        if (attack.sets_used < SAES_WORDS) {
+            stats->samples[active]++;
+            for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+                stats->survivors[active][pos] += small_mask_count(&masks[pos]) - 1; // The correct guess always passes
+            }
+        }
+        saes_attack_add_masks(&attack, masks);
+    }
+
+    unsigned char recovered[SAES_WORDS];
+    if (!saes_attack_recover_key(&attack, recovered)) {
+        stats->incomplete++;
+    } else if (memcmp(recovered, key, SAES_WORDS) != 0) {
+        stats->wrong++;
+    } else {
+        stats->sets_needed[attack.sets_used]++;
+    }
+}
+
+void* experiment_thread(void* arg) {
+    Experiment* experiment = ((void**) arg)[0];
+    Statistics* stats = ((void**) arg)[1];
+    unsigned char key[SAES_WORDS];
+
+    uint64_t first;
+    while ((first = atomic_fetch_add(&experiment->next, KEYS_PER_TASK)) < experiment->keys) {
+        uint64_t last = first + KEYS_PER_TASK < experiment->keys ? first + KEYS_PER_TASK : experiment->keys;
+        for (uint64_t i = first; i < last; i++) {
+            key_from_index(experiment, i, key);
+            attack_key(experiment, key, i, stats);
+        }
+    }
+    return NULL;
+}
+
+/// Check that deriving the previous round keys undoes the key schedule, and that the 4 x 4 variant with 8-bit words is AES.
+bool self_check(size_t rounds) {
+    uint64_t state = 0x2545f4914f6cdd1dULL;
+    unsigned char key[SAES_WORDS], round_keys[(SAES_MAX_ROUNDS + 1) * SAES_WORDS], derived[SAES_WORDS];
+
+    for (int i = 0; i < 1000; i++) {
+        for (size_t w = 0; w < SAES_WORDS; w++) {
+            key[w] = (unsigned char) (next_random(&state) >> 56) & (SAES_VALUES - 1);
+        }
+        saes_expand_key(key, round_keys, rounds);
+        memcpy(derived, &round_keys[rounds * SAES_WORDS], SAES_WORDS);
+        for (size_t r = rounds; r > 0; r--) {
+            saes_derive_previous_key(derived, r - 1);
+        }
+        if (memcmp(derived, key, SAES_WORDS) != 0) {
+            printf("Key schedule check failed: the derived key differs from the original key\n");
+            return false;
+        }
+
+#if SAES_ROWS == 4 && SAES_COLS == 4 && SAES_WORD_BITS == 8
+        unsigned char aes_round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE], block[BLOCK_SIZE], expected[BLOCK_SIZE], actual[BLOCK_SIZE];
+        fill_random(block, BLOCK_SIZE, &state);
+        expand_key(key, aes_round_keys, rounds);
+        encrypt_block(expected, block, aes_round_keys, rounds);
+        saes_encrypt_block(actual, block, round_keys, rounds);
+        if (memcmp(expected, actual, BLOCK_SIZE) != 0) {
+            printf("AES check failed: the 4 x 4 variant with 8-bit words differs from the AES implementation\n");
+            return false;
+        }
+#endif
+    }
+    return true;
+}
+
+void print_usage(const char* name) {
+    printf("Usage: %s [--rounds R] [--keys N] [--max-sets M] [--threads N] [--seed S]\n\n"
+           "Runs the Square Attack on the small scale AES variant with %d x %d words of %d bits against many keys, and prints\n"
+           "the exact distribution of the number of lambda sets needed. Without --keys, all 2^%d keys are attacked if there are\n"
+           "at most 2^%d, and 65536 random keys otherwise.\n", name, SAES_ROWS, SAES_COLS, SAES_WORD_BITS, SAES_KEY_BITS, EXHAUSTIVE_KEY_BITS);
+}
+
+int main(int argc, char* argv[]) {
+    size_t rounds = 4, max_sets = 64;
+    uint64_t keys = 0, seed = 1;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads; // Only an explicit --threads out of range is an error
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--rounds") == 0) {
+            rounds = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--keys") == 0) {
+            keys = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-sets") == 0) {
+            max_sets = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (rounds < 1 || rounds > SAES_MAX_ROUNDS || max_sets < 1 || max_sets > MAX_SETS || threads < 1 || threads > MAX_THREADS) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (!self_check(rounds)) {
+        return 1;
+    }
+
+    Experiment* experiment = tracked_calloc(1, sizeof(Experiment));
+    if (experiment == NULL) {
+        return 1;
+    }
+    experiment->rounds = rounds;
+    experiment->max_sets = max_sets;
+    experiment->seed = seed;
+#if SAES_KEY_BITS <= EXHAUSTIVE_KEY_BITS
+    experiment->exhaustive = keys == 0;
+    experiment->keys = experiment->exhaustive ? (uint64_t) 1 << SAES_KEY_BITS : keys;
+#else
+    experiment->keys = keys > 0 ? keys : 65536;
+#endif
+
+    printf("SR(%zu, %d, %d, %d): attacking %s%llu keys with up to %zu lambda sets of %d texts, using %ld threads\n\n",
+           rounds, SAES_ROWS, SAES_COLS, SAES_WORD_BITS, experiment->exhaustive ? "all " : "", (unsigned long long) experiment->keys,
+           max_sets, SAES_VALUES, threads);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t workers[MAX_THREADS];
+    bool started[MAX_THREADS];
+    void* args[MAX_THREADS][2];
+    for (long t = 0; t < threads; t++) {
+        args[t][0] = experiment;
+        args[t][1] = &experiment->stats[t];
+        started[t] = pthread_create(&workers[t], NULL, experiment_thread, args[t]) == 0;
+        if (!started[t]) {
+            experiment_thread(args[t]); // Fall back to doing the work on this thread
+        }
+    }
+    for (long t = 0; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(workers[t], NULL);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    Statistics total = {0};
+    for (long t = 0; t < threads; t++) {
+        for (size_t i = 0; i <= MAX_SETS; i++) {
+            total.sets_needed[i] += experiment->stats[t].sets_needed[i];
+        }
+        total.incomplete += experiment->stats[t].incomplete;
+        total.wrong += experiment->stats[t].wrong;
+        for (size_t active = 0; active < SAES_WORDS; active++) {
+            total.samples[active] += experiment->stats[t].samples[active];
+            for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+                total.survivors[active][pos] += experiment->stats[t].survivors[active][pos];
+            }
+        }
+    }
+
+    // A word is filtered by a set if wrong guesses survived it at about the rate 2^-e rather than always. Positions that were
+    // never used as the active word, because every key was recovered before, are assumed to filter every word.
+    bool filters[SAES_WORDS][SAES_WORDS];
+    for (size_t active = 0; active < SAES_WORDS; active++) {
+        for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+            filters[active][pos] = total.samples[active] == 0 || total.survivors[active][pos] < total.samples[active] * (SAES_VALUES - 1) / 2;
+        }
+    }
+
+    // The model assumes that a wrong guess passes every set that filters its word independently with probability 2^-e
+    double n = (double) experiment->keys;
+    printf("sets        keys   fraction  cumulative     model\n");
+    uint64_t cumulative = 0;
+    for (size_t i = 1; i <= max_sets; i++) {
+        if (total.sets_needed[i] == 0 && cumulative == 0) {
+            continue;
+        }
+        cumulative += total.sets_needed[i];
+        double model = 1;
+        for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+            size_t filtered = 0;
+            for (size_t set = 0; set < i; set++) {
+                filtered += filters[set % SAES_WORDS][pos];
+            }
+            model *= pow(1 - pow(2, -(double) SAES_WORD_BITS * (double) filtered), SAES_VALUES - 1);
+        }
+        printf("%4zu  %10llu   %8.6f    %8.6f  %8.6f\n", i, (unsigned long long) total.sets_needed[i], total.sets_needed[i] / n,
+               cumulative / n, model);
+        if (cumulative + total.incomplete + total.wrong == experiment->keys) {
+            break;
+        }
+    }
+
+    printf("\nSurvival of wrong guesses after the first lambda set, with word 0 active (model %.6f):\n", 1.0 / SAES_VALUES);
+    for (size_t pos = 0; pos < SAES_WORDS; pos++) {
+        printf("%s%.6f", pos % SAES_COLS == 0 ? "  " : " ", total.survivors[0][pos] / ((double) total.samples[0] * (SAES_VALUES - 1)));
+        if (pos % SAES_COLS == SAES_COLS - 1) {
+            printf("\n");
+        }
+    }
+
+    printf("\nRecovered %llu of %llu keys, %llu incomplete after %zu sets, %llu wrong, in %.2f s\n",
+           (unsigned long long) cumulative, (unsigned long long) experiment->keys, (unsigned long long) total.incomplete, max_sets,
+           (unsigned long long) total.wrong, elapsed);
+
+    tracked_free(experiment);
+    return total.wrong == 0 ? 0 : 1;
+}
@@ -1,10 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "AES/aes.h"
+#include "Engines/engine.h"
+#include "Helpers/alloc_track.h"
 #include "Helpers/helpers.h"
-#include "Helpers/set.h"
+#include "SquareAttack/attack.h"
+#include "SquareAttack/checkpoint.h"
+#include "SquareAttack/planner.h"
+#include "SquareAttack/shard.h"
 #include "SquareAttack/square.h"
 
 // Example on p. 34 of FIPS 197
@@ -15,125 +21,273 @@ const unsigned char DEFAULT_CIPHER_KEY[] = {0x2b, 0x28, 0xab, 0x09,
 
 const int DEFAULT_ROUNDS = 4;
 
-/// Checks all sets of guesses (one set for each byte position) to see whether there is only one guess.
-/// If there is more than one, the search has to be continued until only one candidate is left, which will 100% be the correct one.
-bool has_found_entire_last_round_key(SimpleSet guesses[], size_t n) {
-    bool all_have_exactly_one = true;
-    for (size_t i = 0; i < n; i++) {
-        if (set_length(&guesses[i]) != 1) {
-            all_have_exactly_one = false;
-            break;
-        }
+// With --workers, stop collecting lambda sets once this few last round keys are left, and test them all against known pairs instead
+const unsigned int VERIFY_SPACE_BITS = 24;
+const size_t VERIFY_PAIRS = 2;
+
+const size_t SELF_TEST_ITERATIONS = 100;
+
+// The first batch of lambda sets is sized to complete the attack with this probability, and is capped to keep a typo from requesting millions of sets
+const double DEFAULT_TARGET_PROBABILITY = 0.99;
+const size_t MAX_PLANNED_SETS = 64;
+
+/// State shared with the progress callback while the workers are running.
+typedef struct {
+    ShardJob* job;
+    Checkpoint* checkpoint; // NULL if checkpoints are disabled
+    CheckpointState* state;
+} VerifyProgress;
+
+/// Print the combined progress of the verification workers on a single line, and checkpoint the shards they have completed.
+void print_progress(uint64_t done, uint64_t total, void* user) {
+    VerifyProgress* vp = user;
+    if (vp->checkpoint != NULL) {
+        vp->state->found = shard_job_snapshot(vp->job, vp->state->shard_done, vp->state->found_keys[0], SHARD_MAX_RESULTS);
+        checkpoint_save(vp->checkpoint, vp->state);
     }
 
-    return all_have_exactly_one;
+    printf("\rVerified %llu of %llu candidate keys", (unsigned long long) done, (unsigned long long) total);
+    if (done == total) {
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+/// Test every last round key that can be built from the remaining candidates in parallel worker processes.
+/// Returns true and writes the original cipher key into key if exactly one of them matches all known pairs.
+/// If the state was loaded from a checkpoint of the same guess space, the shards that were already completed are skipped.
+bool verify_candidates(const AttackContext* ctx, const unsigned char* round_keys, size_t workers,
+                       Checkpoint* checkpoint, CheckpointState* state, unsigned char* key) {
+    unsigned char plaintexts[VERIFY_PAIRS * BLOCK_SIZE], ciphertexts[VERIFY_PAIRS * BLOCK_SIZE];
+    for (size_t i = 0; i < VERIFY_PAIRS; i++) {
+        fill_block(&plaintexts[i * BLOCK_SIZE], 0x5a + i); // Any known plaintexts will do, they only have to differ from each other
+    }
+    encrypt_blocks(ciphertexts, plaintexts, VERIFY_PAIRS, round_keys, ctx->rounds);
+
+    ShardJob* job = shard_job_create(ctx, plaintexts, ciphertexts, VERIFY_PAIRS);
+    if (job == NULL) {
+        return false;
+    }
+
+    if (state->space == job->space) {
+        shard_job_restore(job, state->shard_done, state->found_keys[0], state->found);
+    } else {
+        state->space = job->space;
+        state->found = 0;
+        memset(state->shard_done, 0, sizeof(state->shard_done));
+    }
+
+    VerifyProgress vp = {job, checkpoint, state};
+    fflush(stdout); // Don't let the workers inherit unwritten output
+    bool found = shard_job_run(job, workers, print_progress, &vp) == 0 && shard_job_results(job, key, 1) == 1;
+    shard_job_destroy(job);
+    return found;
+}
+
+void print_usage(const char* name) {
+    printf("Usage: %s [--workers N] [--checkpoint FILE] [--resume] [--engine NAME] [--analysis-engine NAME] [--target P]\n"
+           "       [--alloc-report] [--self-test] [KEY]\n\n"
+           "Runs the Square Attack against %d rounds of AES with KEY, a 32-char hex string read row by row, or the FIPS 197 sample key.\n",
+           name, DEFAULT_ROUNDS);
 }
 
 int main(int argc, char* argv[])
 {
-    unsigned char* key;
+    unsigned char key[BLOCK_SIZE];
     size_t rounds = DEFAULT_ROUNDS;
+    size_t workers = 0;
+    const char* key_arg = NULL;
+    const char* checkpoint_path = NULL;
+    bool resume = false;
+    const char* encrypt_engine_name = NULL;
+    const char* analysis_engine_name = NULL;
+    double target = DEFAULT_TARGET_PROBABILITY;
+    bool report_allocations = false;
 
-    if (argc != 2) { // first argument is executable name + path, therefore it is 3 and not 2
+    for (int i = 1; i < argc; i++) { // first argument is executable name + path
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--workers") == 0 && has_value) {
+            workers = strtoul(argv[++i], NULL, 10);
+            if (workers == 0 || workers > SHARD_MAX_WORKERS) {
+                printf("The number of workers has to be between 1 and %d.\n", SHARD_MAX_WORKERS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && has_value) {
+            checkpoint_path = argv[++i];
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = true;
+        } else if (strcmp(argv[i], "--engine") == 0 && has_value) {
+            encrypt_engine_name = argv[++i];
+        } else if (strcmp(argv[i], "--analysis-engine") == 0 && has_value) {
+            analysis_engine_name = argv[++i];
+        } else if (strcmp(argv[i], "--target") == 0 && has_value) {
+            target = strtod(argv[++i], NULL);
+            if (target < 0 || target >= 1) {
+                printf("The target success probability has to be at least 0 and less than 1.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--alloc-report") == 0) {
+            report_allocations = true;
+        } else if (strcmp(argv[i], "--self-test") == 0) {
+            return engine_self_test(SELF_TEST_ITERATIONS, stdout) == 0 ? 0 : 1;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            printf("Unknown option %s, or it is missing its value.\n\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        } else if (key_arg == NULL) {
+            key_arg = argv[i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    alloc_phase("setup");
+
+    const EncryptEngine* encrypt_engine = select_encrypt_engine(encrypt_engine_name);
+    const AnalysisEngine* analysis_engine = select_analysis_engine(analysis_engine_name);
+    if (encrypt_engine == NULL || analysis_engine == NULL) {
+        printf("The selected engine does not exist or is not supported by this CPU, see --self-test for a list of engines.\n");
+        return 1;
+    }
+
+    if (key_arg == NULL) {
         printf("Provide a 16 byte cipher key in hex as an argument to use it as the cipher key "
                "for the Square Attack. Continuing with sample cipher key.\n\n");
 
-        key = malloc(BLOCK_SIZE);
         memcpy(key, DEFAULT_CIPHER_KEY, BLOCK_SIZE);
-    } else {
-        // Parse the arguments as blocks, and the number of rounds
-        key = block_from_string(argv[1]);
+    } else if (!parse_block(key_arg, key)) {
+        printf("The cipher key has to be a 32-char hex string.\n");
+        return 1;
     }
 
     print_with_msg(key, "Encrypting lambda sets with the cipher key:");
 
-    SimpleSet all_guesses[BLOCK_SIZE]; // Store all guesses for each position in the key in a set
-    for (size_t i = 0; i < BLOCK_SIZE; i++) {
-        set_init(&all_guesses[i]); // Initialize each set
-    }
+    // The round keys play the role of the encryption oracle, the attack itself only ever sees the encrypted lambda sets
+    unsigned char round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+    expand_key(key, round_keys, rounds);
 
-    // Collect all_guesses from random lambda sets until there is only a single candidate left for all positions
-    size_t iter = 0;
-    while (!has_found_entire_last_round_key(all_guesses, BLOCK_SIZE)) {
-        iter++;
+    AttackContext ctx;
+    attack_init(&ctx, rounds);
 
-        // Generate lambda set with increasing values in position 0, and random values in other positions (that are the same across all blocks)
-        unsigned char** lambda = generate_lambda_set(iter);
+    // Checkpoints are written to a memory-mapped file after every lambda set, and about once per second while the workers are running
+    static CheckpointState state; // Too large to comfortably live on the stack
+    Checkpoint checkpoint;
+    Checkpoint* cp = NULL;
+    if (checkpoint_path != NULL) {
+        CheckpointTarget target;
+        checkpoint_target(&target, encrypt_engine->encrypt_blocks, round_keys, rounds);
+        int result = checkpoint_open(&checkpoint, checkpoint_path, resume, &target);
+        if (result == CHECKPOINT_OTHER_TARGET) {
+            printf("Checkpoint file %s belongs to another cipher key or number of rounds, and cannot be resumed.\n", checkpoint_path);
+            return 1;
+        } else if (result != 0) {
+            printf("Could not open checkpoint file %s.\n", checkpoint_path);
+            return 1;
+        }
+        cp = &checkpoint;
 
-        for (size_t i = 0; i < SETS; i++) {
-            lambda[i] = encrypt(lambda[i], key, rounds);
+        if (resume && checkpoint_load(cp, &state) && state.ctx.rounds == rounds) {
+            ctx = state.ctx;
+            printf("Resuming from checkpoint after %llu lambda sets.\n\n", (unsigned long long) state.seeds_used);
+        } else {
+            memset(&state, 0, sizeof(state));
         }
+    }
 
-        // For each of the 16 positions, guess the byte of the key corresponding to the position, using the encrypted lambda set
-        for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
-            // Guess the possible round keys for each position in the block
-            size_t no_of_guesses;
-            unsigned char* guesses = guess_round_key(lambda, pos, &no_of_guesses);
-
-            // Create a new set containing the new guesses, and form an intersection with the existing guesses so that only the matching ones remain
-            SimpleSet new_guesses;
-            set_init(&new_guesses);
-            for (size_t i = 0; i < no_of_guesses; i++) {
-                set_add(&new_guesses, format_str("%02x", guesses[i])); // Set implementation only supports strings, so we store it as a hex string
-            }
+    // Request as many lambda sets up front as the planner predicts are needed, so that they are encrypted in a single call to the oracle
+    // and analysed in parallel. If that was not enough, top up with one set at a time. With workers, a single set is usually enough.
+    size_t batch = 1;
+    if (workers == 0 && target > 0 && !attack_is_complete(&ctx)) {
+        batch = plan_attack(&ctx, target);
+        batch = batch > MAX_PLANNED_SETS ? MAX_PLANNED_SETS : batch;
+        printf("Requesting %zu lambda sets at once for a success probability of %g.\n\n", batch, target);
+    }
+    unsigned char* lambdas = tracked_malloc(batch * SETS * BLOCK_SIZE);
+    size_t threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    unsigned char key_block[BLOCK_SIZE];
+    char msg[256];
 
-            free(guesses);
+    // Collect guesses from lambda sets until there is only a single candidate left for all positions
+    alloc_phase("attack");
+    size_t iter = state.seeds_used;
+    bool verified = false;
+    while (!attack_is_complete(&ctx)) {
+        uint64_t space;
+        if (workers > 0 && ctx.sets_used > 0 && attack_guess_space(&ctx, VERIFY_SPACE_BITS, &space)) {
+            printf("Testing the remaining %llu last round keys with %zu workers\n", (unsigned long long) space, workers);
+            unsigned char cipher_key[BLOCK_SIZE];
+            verified = verify_candidates(&ctx, round_keys, workers, cp, &state, cipher_key);
+            printf("\n");
 
-            if (set_length(&all_guesses[pos]) == 0) {
-                all_guesses[pos] = new_guesses; // No guessed added yet, so an intersection would be the empty set
-            } else if (set_length(&new_guesses) > 0) { // Only create intersection if there are actually any new guesses (which should always be the case)
-                SimpleSet intersection;
-                set_init(&intersection);
-                set_intersection(&intersection, &all_guesses[pos], &new_guesses); // The intersection only contains the guesses contained in all iterations
-                set_destroy(&all_guesses[pos]); // destroy old set
-                all_guesses[pos] = intersection;
+            if (verified) {
+                unsigned char cipher_round_keys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+                expand_key(cipher_key, cipher_round_keys, rounds);
+                memcpy(key_block, &cipher_round_keys[rounds * BLOCK_SIZE], BLOCK_SIZE);
+                break;
             }
+            workers = 0; // Fall back to collecting lambda sets
         }
 
+        // Generate lambda sets with increasing values in position 0, and random values in other positions (that are the same across all blocks)
+        for (size_t b = 0; b < batch; b++) {
+            fill_lambda_set(&lambdas[b * SETS * BLOCK_SIZE], iter + b + 1);
+        }
+        encrypt_engine->encrypt_blocks(lambdas, lambdas, batch * SETS, round_keys, rounds);
+
+        // For each of the 16 positions, guess the byte of the key and intersect it with the previous guesses
+        attack_add_lambda_sets(&ctx, analysis_engine->evaluate, lambdas, batch, threads);
+        iter += batch;
+        batch = 1;
+
         // Print current guesses
         printf("Guesses after iteration %zu:\n", iter);
         for (size_t pos = 0; pos < BLOCK_SIZE; pos++) {
-            size_t size;
-            char** guesses = set_to_array(&all_guesses[pos], &size);
+            unsigned char guesses[SETS];
+            size_t size = attack_candidates(&ctx, pos, guesses);
             printf("Current guesses for byte position %zu: ", pos);
             for (size_t i = 0; i < size; i++) {
-                printf("%s ", guesses[i]);
+                printf("%02x ", guesses[i]);
             }
             printf("\n");
         }
         printf("\n");
+
+        if (cp != NULL) {
+            state.ctx = ctx;
+            state.seeds_used = iter;
+            state.corpus_offset = iter * SETS;
+            checkpoint_save(cp, &state);
+        }
     }
 
     // Print out the last round key that was found
-    char* key_guess = malloc(sizeof(char) * BLOCK_SIZE * 2); // 32-char long key in hex format
-    for (size_t i = 0; i < BLOCK_SIZE; i++) {
-        size_t size;
-        char** guesses = set_to_array(&all_guesses[i], &size); // Will only contain one item, otherwise we wouldn't be here
-        char* correct_guess = guesses[0];
-        key_guess[i * 2] = guesses[0][0]; // First character of 2-char long hex code
-        key_guess[i * 2 + 1] = guesses[0][1]; // Second character of 2-char long hex code
+    alloc_phase("results");
+    if (!verified) {
+        attack_last_round_key(&ctx, key_block);
     }
-
-    // Parse block from hex string back into a block, and print it out
-    unsigned char* key_block = block_from_string(key_guess);
-    print_with_msg(key_block, format_str("Found last round key after reversing %zu lambda sets:", iter));
+    snprintf(msg, sizeof(msg), "Found last round key after reversing %zu lambda sets:", iter);
+    print_with_msg(key_block, msg);
 
     // Derive previous round keys from the guessed one until original key is found
-    for (int round = DEFAULT_ROUNDS - 1; round >= 0; round--) {
+    for (int round = (int) rounds - 1; round >= 0; round--) {
         derive_previous_key(key_block, round);
         if (round == 0) {
-            print_with_msg(key_block, format_str("Recovered original cipher key:", round));
+            print_with_msg(key_block, "Recovered original cipher key:");
         } else {
-            print_with_msg(key_block, format_str("Recovered previous round key (round %zu)", round));
+            snprintf(msg, sizeof(msg), "Recovered previous round key (round %d)", round);
+            print_with_msg(key_block, msg);
         }
     }
 
-    // Clear memory
-    for (size_t i = 0; i < BLOCK_SIZE; i++) {
-        set_destroy(&all_guesses[i]);
+    if (cp != NULL) {
+        checkpoint_close(cp);
     }
+    tracked_free(lambdas);
 
-    free(key);
-    free(key_guess);
-    free(key_block);
+    if (report_allocations) {
+        printf("\n");
+        alloc_report(stdout);
+    }
 }
\ No newline at end of file